@@ -17,6 +17,7 @@
 
 #if defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 199309L
 #include <signal.h>
+#include <time.h>
 #endif
 
 /** \file byztime.h */
@@ -51,11 +52,15 @@ int byztime_stamp_normalize(byztime_stamp *stamp);
     \param[in] stamp1 The first summand.
     \param[in] stamp2 The second summand.
 
+   The inputs need not be normalized. The result is always normalized,
+   and the function fails only if it is not representable, even when an
+   intermediate such as the sum of the `seconds` fields is not.
+
    \returns 0 on success.
    \returns -1 on failure and sets `errno`.
 
-   \exception EOVERFLOW The operation caused an integer overflow/underflow,
-   and was completed with 2-complement wraparound semantics.
+   \exception EOVERFLOW The result overflowed, and was completed with
+   2-complement wraparound semantics.
 */
 int byztime_stamp_add(byztime_stamp *sum, byztime_stamp const *stamp1,
                       byztime_stamp const *stamp2);
@@ -66,11 +71,14 @@ int byztime_stamp_add(byztime_stamp *sum, byztime_stamp const *stamp1,
     \param[in] stamp1 The minuend.
     \param[in] stamp2 The subtrahend.
 
+   As for byztime_stamp_add(), the inputs need not be normalized, and
+   the function fails only if the result is not representable.
+
    \returns 0 on success.
    \returns -1 on failure and sets `errno`.
 
-   \exception EOVERFLOW The operation caused an integer overflow/underflow,
-   and was completed with 2-complement wraparound semantics.
+   \exception EOVERFLOW The result overflowed, and was completed with
+   2-complement wraparound semantics.
 */
 int byztime_stamp_sub(byztime_stamp *diff, byztime_stamp const *stamp1,
                       byztime_stamp const *stamp2);
@@ -80,9 +88,8 @@ int byztime_stamp_sub(byztime_stamp *diff, byztime_stamp const *stamp1,
     \param[in] stamp1 The first timestamp to be compared.
     \param[out] stamp2 The second timestamp to be compared.
 
-   This function has no means of signaling whether normalizing the inputs
-   resulted in an overflow. In case of concern, pass inputs that are already
-   normalized.
+   The comparison is exact, even for non-normalized inputs whose
+   normalized `seconds` would not fit in 64 bits.
 
    \returns -1 if stamp1 < stamp2
    \returns 0 if stamp1 == stamp2
@@ -96,11 +103,15 @@ int byztime_stamp_cmp(byztime_stamp const *stamp1, byztime_stamp const *stamp2);
     \param[in] stamp The timestamp to be scaled.
     \param[ppb] ppb The amount by which to scale `stamp`, in parts per billion.
 
+   The product is rounded to the nearest nanosecond, with ties to even.
+   As for byztime_stamp_add(), `stamp` need not be normalized, and the
+   function fails only if the result is not representable.
+
    \returns 0 on success.
    \returns -1 on failure and sets `errno`.
 
-   \exception EOVERFLOW The operation caused an integer overflow/underflow,
-   and was completed with 2-complement wraparound semantics.
+   \exception EOVERFLOW The result overflowed, and was completed with
+   2-complement wraparound semantics.
  */
 int byztime_stamp_scale(byztime_stamp *prod, byztime_stamp const *stamp,
                         int64_t ppb);
@@ -111,9 +122,12 @@ int byztime_stamp_scale(byztime_stamp *prod, byztime_stamp const *stamp,
     \param[in] stamp The timestamp to be scaled.
 
     This function is much faster than calling byztime_stamp_scale() with
-    ppb=500_000_000.
+    ppb=500_000_000, and rounds the same way, to the nearest nanosecond
+    with ties to even.
 
-    If `stamp` is non-normalized then `prod` may be non-normalized as well.
+    If `stamp` is non-normalized then `prod` may be non-normalized as well,
+    but it still has exactly the value that byztime_stamp_scale() would
+    give.
 
     \returns void. This function always succeeds.
 */
@@ -138,6 +152,380 @@ void byztime_stamp_halve(byztime_stamp *prod, byztime_stamp const *stamp);
 
 size_t byztime_stamp_fmt(char *str, size_t size, byztime_stamp const *stamp);
 
+/** A timestamp broken down into a date and time of day in the proleptic
+    Gregorian calendar, without time zones or leap seconds. */
+typedef struct byztime_civil_s {
+  int64_t year;   /**< Year, counting 1 BC as 0 and 2 BC as -1. */
+  int month;      /**< Month of the year, from 1 to 12. */
+  int day;        /**< Day of the month, from 1 to 31. */
+  int hour;       /**< Hour, from 0 to 23. */
+  int minute;     /**< Minute, from 0 to 59. */
+  int second;     /**< Second, from 0 to 59. */
+  int nanosecond; /**< Nanosecond, from 0 to 999999999. */
+  int weekday;    /**< Day of the week, 0 for Sunday. Ignored on input. */
+} byztime_civil;
+
+/** Breaks a timestamp down into a date and time of day.
+
+    The timestamp is taken as seconds since 1970-01-01 00:00:00, in the
+    same way as POSIX time. Unlike `gmtime_r()`, this takes no locks,
+    consults no time zone data, and handles the full range of
+    byztime_stamp.
+
+    \param[out] civil The broken-down time.
+    \param[in] stamp The timestamp, which need not be normalized.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EOVERFLOW Normalizing `stamp` overflowed.
+*/
+int byztime_stamp_to_civil(byztime_civil *civil, byztime_stamp const *stamp);
+
+/** Converts a date and time of day into a timestamp. This is the inverse
+    of byztime_stamp_to_civil().
+
+    \param[out] stamp The normalized timestamp.
+    \param[in] civil The broken-down time. Fields other than `weekday`
+    must be within their documented ranges, and `day` must exist in the
+    given month.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL A field is out of range.
+    \exception EOVERFLOW The time is not representable as a byztime_stamp.
+*/
+int byztime_stamp_from_civil(byztime_stamp *stamp, byztime_civil const *civil);
+
+/** Breaks down `n` timestamps, as for byztime_stamp_to_civil().
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`. Elements before the failing
+    one have been converted, and those after it have not.
+*/
+int byztime_stamp_to_civil_batch(byztime_civil civil[],
+                                 byztime_stamp const stamps[], size_t n);
+
+/** Converts `n` broken-down times into timestamps, as for
+    byztime_stamp_from_civil().
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`. Elements before the failing
+    one have been converted, and those after it have not.
+*/
+int byztime_stamp_from_civil_batch(byztime_stamp stamps[],
+                                   byztime_civil const civil[], size_t n);
+
+/** Stamps stored as a structure of arrays.
+
+    The `k`th stamp is (`seconds[k]`, `nanoseconds[k]`). Unlike arrays of
+    byztime_stamp, columns let comparisons and arithmetic over many stamps
+    be vectorized. The column functions below all take the number of
+    stamps as a separate argument, and all require their inputs to be
+    normalized; their outputs are normalized in turn. An output may be
+    the same columns as one of the inputs. */
+typedef struct byztime_stamp_columns_s {
+  int64_t *seconds;     /**< Column of `seconds` fields. */
+  int64_t *nanoseconds; /**< Column of `nanoseconds` fields. */
+} byztime_stamp_columns;
+
+/** Copies `n` stamps into columns. */
+void byztime_columns_from_stamps(byztime_stamp_columns const *out,
+                                 byztime_stamp const stamps[], size_t n);
+
+/** Copies `n` stamps out of columns. */
+void byztime_columns_to_stamps(byztime_stamp stamps[],
+                               byztime_stamp_columns const *in, size_t n);
+
+/** Adds columns element-wise.
+
+   \returns 0 on success.
+   \returns -1 on failure and sets `errno`.
+
+   \exception EOVERFLOW At least one sum overflowed, and was completed
+   with 2-complement wraparound semantics. The other sums are correct.
+*/
+int byztime_columns_add(byztime_stamp_columns const *sum,
+                        byztime_stamp_columns const *a,
+                        byztime_stamp_columns const *b, size_t n);
+
+/** Subtracts columns element-wise, as for byztime_columns_add(). */
+int byztime_columns_sub(byztime_stamp_columns const *diff,
+                        byztime_stamp_columns const *a,
+                        byztime_stamp_columns const *b, size_t n);
+
+/** Compares columns element-wise, setting `out[k]` to -1, 0 or 1 as
+    byztime_stamp_cmp() would return for the `k`th stamps. */
+void byztime_columns_cmp(int8_t out[], byztime_stamp_columns const *a,
+                         byztime_stamp_columns const *b, size_t n);
+
+/** Takes the element-wise minimum of two columns. */
+void byztime_columns_min(byztime_stamp_columns const *out,
+                         byztime_stamp_columns const *a,
+                         byztime_stamp_columns const *b, size_t n);
+
+/** Takes the element-wise maximum of two columns. */
+void byztime_columns_max(byztime_stamp_columns const *out,
+                         byztime_stamp_columns const *a,
+                         byztime_stamp_columns const *b, size_t n);
+
+/** Sets `mask[k]` to 1 if `lo <= stamp k <= hi`, and to 0 otherwise. */
+void byztime_columns_in_range(uint8_t mask[], byztime_stamp_columns const *in,
+                              byztime_stamp const *lo, byztime_stamp const *hi,
+                              size_t n);
+
+/** Finds the stamps in `[lo, hi]`.
+
+    \param[out] indices Array with room for `n` entries, which receives
+    the indices of matching stamps in increasing order. Entries beyond the
+    returned count are clobbered.
+    \param[in] in The columns to search.
+    \param[in] lo Lower bound, inclusive.
+    \param[in] hi Upper bound, inclusive.
+    \param[in] n Number of stamps.
+
+    \returns The number of matching stamps.
+*/
+size_t byztime_columns_filter(size_t indices[], byztime_stamp_columns const *in,
+                              byztime_stamp const *lo, byztime_stamp const *hi,
+                              size_t n);
+
+/** @} */
+/** \defgroup arrow Apache Arrow export
+    @{
+*/
+
+/** Opaque type of an Arrow IPC writer. */
+typedef struct byztime_arrow_writer_s byztime_arrow_writer;
+
+/** Format for byztime_arrow_open(): Arrow IPC streaming format. */
+#define BYZTIME_ARROW_STREAM 0
+/** Format for byztime_arrow_open(): Arrow IPC file format, also known as
+    Feather version 2. */
+#define BYZTIME_ARROW_FILE 1
+
+/** Starts writing an Arrow IPC stream or file of timestamp columns.
+
+    The output has one non-nullable column of type `timestamp[ns, UTC]`
+    for each name in `names`, and is written to `fd` starting at its
+    current position, beginning with the schema. Rows are appended in
+    record batches by byztime_arrow_write_ns() and
+    byztime_arrow_write_stamps(), and the output is completed by
+    byztime_arrow_close(). The writer has no dependencies beyond libc.
+
+    \param[in] fd File descriptor to write to. The writer never seeks,
+    so this may be a pipe or socket when `format` is
+    `BYZTIME_ARROW_STREAM`.
+    \param[in] format `BYZTIME_ARROW_STREAM` or `BYZTIME_ARROW_FILE`.
+    \param[in] names Column names, which are copied.
+    \param[in] ncolumns Number of columns.
+
+    \returns A pointer to the new writer on success.
+    \returns `NULL` on failure and sets `errno`.
+
+    \exception EINVAL `format` is invalid or `ncolumns` is zero.
+
+    In addition, any error set by `writev()` may be returned.
+*/
+byztime_arrow_writer *byztime_arrow_open(int fd, int format,
+                                         char const *const names[],
+                                         size_t ncolumns);
+
+/** Writes a record batch from columns of nanoseconds since the epoch.
+
+    The columns are written straight from the caller's buffers, with no
+    intermediate copy.
+
+    \param[in] w The writer.
+    \param[in] columns One array of `nrows` UTC timestamps in nanoseconds
+    per column.
+    \param[in] nrows Number of rows.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`. After a failed write, the
+    output is incomplete and every later call fails with `EIO`.
+*/
+int byztime_arrow_write_ns(byztime_arrow_writer *w,
+                           int64_t const *const columns[], size_t nrows);
+
+/** Writes rows from columns of global timestamps.
+
+    Each stamp is converted to UTC by subtracting `real_offset`, which is
+    normally obtained from byztime_get_real_offset(). Local timestamps
+    should be converted to global time first. Conversion happens a few
+    thousand rows at a time, each chunk being written as a record batch
+    of its own.
+
+    \param[in] w The writer.
+    \param[in] columns One array of `nrows` normalized stamps per column.
+    \param[in] nrows Number of rows.
+    \param[in] real_offset Global time minus UTC, or `NULL` if the
+    stamps are already UTC.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EOVERFLOW A timestamp is not representable as 64 bits of
+    nanoseconds. Rows before the chunk containing it have been written.
+*/
+int byztime_arrow_write_stamps(byztime_arrow_writer *w,
+                               byztime_stamp const *const columns[],
+                               size_t nrows, byztime_stamp const *real_offset);
+
+/** Completes the output and frees the writer.
+
+    Writes the end-of-stream marker and, for `BYZTIME_ARROW_FILE`, the
+    footer. The file descriptor is not closed. The writer is freed even
+    on failure.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+*/
+int byztime_arrow_close(byztime_arrow_writer *w);
+
+/** Frees a writer without completing the output. If `w` is `NULL`, this
+    is a no-op. */
+void byztime_arrow_abort(byztime_arrow_writer *w);
+
+/** @} */
+/** \defgroup index Time index for log segments
+    @{
+*/
+
+/** Opaque type of a time index under construction. */
+typedef struct byztime_index_writer_s byztime_index_writer;
+
+/** Opaque type of an open time index. */
+typedef struct byztime_index_s byztime_index;
+
+/** Starts building a sparse time index for an append-only log segment.
+
+    The log is assumed to consist of records, each stamped with an
+    interval of global time such as one returned by
+    byztime_get_global_time(). The records need not be in time order.
+    The index describes the log in blocks of `stride` records, so it is
+    about `40 / stride` bytes per record, and lets
+    byztime_index_query() find the part of the log that can contain
+    records from a given time range with a binary search instead of a
+    scan.
+
+    The index is kept in memory until byztime_index_finish(), which
+    writes it to `path`.
+
+    \param[in] path The file to which the index will be written.
+    \param[in] stride Number of records per block.
+
+    \returns A pointer to the new writer on success.
+    \returns `NULL` on failure and sets `errno`.
+
+    \exception EINVAL `stride` is zero.
+*/
+byztime_index_writer *byztime_index_create(char const *path, uint32_t stride);
+
+/** Adds a record to a time index.
+
+    \param[in] w The writer.
+    \param[in] offset Byte offset of the record in the log. Offsets must
+    strictly increase from one record to the next, so that every record
+    starts at a distinct byte and the ranges returned by
+    byztime_index_query() cover exactly the records they should.
+    \param[in] min Lower bound of the record's timestamp.
+    \param[in] max Upper bound of the record's timestamp.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `offset` is not greater than the previous record's.
+*/
+int byztime_index_add(byztime_index_writer *w, uint64_t offset,
+                      byztime_stamp const *min, byztime_stamp const *max);
+
+/** Seals a time index, writes it out, and frees the writer.
+
+    The index file is written under a temporary name and renamed into
+    place, so it is never seen partially written. The writer is freed
+    even on failure.
+
+    \param[in] w The writer.
+    \param[in] end_offset Length of the log segment, which is the end of
+    the last block.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `end_offset` is not greater than the last record's
+    offset.
+
+    In addition, any error set by `mkostemp()`, `write()`, `fsync()` or
+    `rename()` may be returned.
+*/
+int byztime_index_finish(byztime_index_writer *w, uint64_t end_offset);
+
+/** Frees a time index writer without writing anything. If `w` is `NULL`,
+    this is a no-op. */
+void byztime_index_abort(byztime_index_writer *w);
+
+/** Opens a time index written by byztime_index_finish().
+
+    The index is memory-mapped, so a query touches only the few pages
+    its binary search visits. Index files are in host byte order and
+    are rejected on hosts of the other byte order.
+
+    \param[in] path The index file.
+
+    \returns A pointer to the index on success.
+    \returns `NULL` on failure and sets `errno`.
+
+    \exception EPROTO The file is not a valid index.
+
+    In addition, any error set by `open()`, `fstat()`, or `mmap()` may be
+    returned.
+*/
+byztime_index *byztime_index_open(char const *path);
+
+/** Finds the part of a log segment that can contain records from a time
+    range.
+
+    On return, every record whose interval overlaps `[lo, hi]` lies at
+    an offset in `[*begin, *end)`. The range is conservative: it is made
+    of whole blocks and may include records outside `[lo, hi]`, which
+    the caller should filter out as it reads them. If no record can
+    overlap `[lo, hi]` then `*begin == *end`.
+
+    \param[in] idx The index.
+    \param[in] lo Start of the time range.
+    \param[in] hi End of the time range.
+    \param[out] begin Offset of the first record to read.
+    \param[out] end Offset at which to stop reading.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `lo` is later than `hi`.
+*/
+int byztime_index_query(byztime_index const *idx, byztime_stamp const *lo,
+                        byztime_stamp const *hi, uint64_t *begin,
+                        uint64_t *end);
+
+/** Gets the parameters a time index was built with. Any of the output
+    pointers may be `NULL`.
+
+    \param[in] idx The index.
+    \param[out] stride Number of records per block.
+    \param[out] nrecords Number of records indexed.
+    \param[out] end_offset Length of the indexed log segment.
+*/
+void byztime_index_get_info(byztime_index const *idx, uint32_t *stride,
+                            uint64_t *nrecords, uint64_t *end_offset);
+
+/** Closes a time index. If `idx` is `NULL`, this is a no-op.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+*/
+int byztime_index_close(byztime_index *idx);
+
 /** @} */
 /** \defgroup common Common API for consumers and providers
     @{
@@ -187,6 +575,7 @@ int byztime_get_real_time(byztime_stamp *real_time);
     \param[in] ctx Pointer to the context object to be closed.
 
     Using a context object after closing it will result in undefined behavior.
+    Closing the context returned by byztime_default_ctx() does nothing.
 
     \returns 0 on success.
     \returns -1 on failure and sets `errno`.
@@ -214,6 +603,99 @@ int byztime_close(byztime_ctx *ctx);
 */
 byztime_ctx *byztime_open_ro(char const *pathname);
 
+/** Name of the environment variable consulted by byztime_default_ctx(). */
+#define BYZTIME_DEFAULT_PATH_ENV "BYZTIME_TIMEDATA"
+
+/** Timedata path used by byztime_default_ctx() when `BYZTIME_TIMEDATA` is
+    unset or empty. */
+#ifndef BYZTIME_DEFAULT_PATH
+#define BYZTIME_DEFAULT_PATH "/var/lib/byztimed/timedata"
+#endif
+
+/** Returns the process-wide default read-only context.
+
+    The first successful call opens the timedata file named by the
+    `BYZTIME_TIMEDATA` environment variable, or `BYZTIME_DEFAULT_PATH` if
+    it is unset, exactly as byztime_open_ro() would. Every later call, from
+    any thread, returns the same context without making any system calls.
+    This lets several libraries within one process share a single mapping
+    of the timedata file without coordinating with each other.
+
+    Initialization takes no locks: threads that race on the first call each
+    open the file, one of them publishes its context with a
+    compare-and-swap, and the others close theirs and return the winner.
+    Consequently there is no intermediate state for `fork()` to capture, and
+    a child process keeps using the context it inherited, whose shared
+    mapping remains valid across the fork. Failures are not cached, so a
+    call made after byztimed has started will succeed even if an earlier
+    one failed.
+
+    The returned context may be used concurrently from any number of
+    threads for the non-slewing read functions such as
+    byztime_get_global_time() and byztime_get_offset(). It is owned by the
+    library: byztime_close() and byztime_set_drift() are no-ops on it,
+    and byztime_slew() fails with `EPERM`. Libraries that need any of these should open a
+    private context with byztime_open_ro() instead.
+
+    \return A pointer to the default context, or `NULL` on failure and sets
+    `errno` to any value that byztime_open_ro() may set.
+*/
+byztime_ctx *byztime_default_ctx(void);
+
+/** Selects the local clock source automatically. See
+    byztime_set_local_clock(). */
+#define BYZTIME_LOCAL_CLOCK_AUTO 0
+/** Local clock source: read `CLOCK_MONOTONIC_RAW` directly. */
+#define BYZTIME_LOCAL_CLOCK_RAW 1
+/** Local clock source: read `CLOCK_MONOTONIC` and correct it to
+    `CLOCK_MONOTONIC_RAW`. */
+#define BYZTIME_LOCAL_CLOCK_MONOTONIC 2
+
+/** Chooses how a context reads the local clock.
+
+    Local time is always `CLOCK_MONOTONIC_RAW`, but older kernels only
+    serve `CLOCK_MONOTONIC` from the vDSO, so that reading
+    `CLOCK_MONOTONIC_RAW` costs a system call. In
+    `BYZTIME_LOCAL_CLOCK_MONOTONIC` mode, a context reads
+    `CLOCK_MONOTONIC` instead and converts it using a
+    `CLOCK_MONOTONIC`/`CLOCK_MONOTONIC_RAW` sample and rate which the
+    provider publishes with each entry. The error bounds returned by
+    byztime_get_offset(), byztime_get_global_time() and
+    byztime_get_global_time_ns() are widened by the uncertainty of the
+    sample plus 1000 parts per million (the most by which the kernel's
+    NTP discipline can skew `CLOCK_MONOTONIC`) of the time elapsed since
+    it was taken. When the provider publishes no sample, the context
+    reads `CLOCK_MONOTONIC_RAW` regardless of this setting. Providers
+    withhold the sample while the kernel's tick length is adjusted from
+    nominal (`ADJ_TICK`, which can skew `CLOCK_MONOTONIC` by up to 10%)
+    or while they measure a rate difference beyond 1000 parts per
+    million.
+
+    `BYZTIME_LOCAL_CLOCK_AUTO`, which byztime_open_ro() applies when the
+    provider supports it, times both clocks and chooses
+    `BYZTIME_LOCAL_CLOCK_MONOTONIC` only if it is markedly faster on the
+    running kernel.
+
+    \param[in] ctx Pointer to context object.
+    \param[in] clock One of `BYZTIME_LOCAL_CLOCK_AUTO`,
+    `BYZTIME_LOCAL_CLOCK_RAW` or `BYZTIME_LOCAL_CLOCK_MONOTONIC`.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `clock` is not a valid clock source.
+    \exception EPERM `ctx` is the shared context returned by
+    byztime_default_ctx().
+*/
+int byztime_set_local_clock(byztime_ctx *ctx, int clock);
+
+/** Returns the local clock source in use by a context: either
+    `BYZTIME_LOCAL_CLOCK_RAW` or `BYZTIME_LOCAL_CLOCK_MONOTONIC`.
+
+    \param[in] ctx Pointer to context object.
+*/
+int byztime_get_local_clock(byztime_ctx const *ctx);
+
 /** Gets bounds and an estimate of time offset `(global time - local time)`.
 
     \param[in] ctx Pointer to context object.
@@ -236,6 +718,25 @@ byztime_ctx *byztime_open_ro(char const *pathname);
 int byztime_get_offset(byztime_ctx *ctx, byztime_stamp *min, byztime_stamp *est,
                        byztime_stamp *max);
 
+/** Gets the difference between global time and real time.
+
+    This is the value that the provider recorded for recovering global
+    time after a reboot. Providers using this version of the library
+    publish it with each entry, and then the value returned is the one
+    that was current when the current entry was published (see
+    byztime_publish()). With older providers it is read from the timedata
+    file's header.
+
+    \param[in] ctx Pointer to context object.
+    \param[out] real_offset Global time minus real time.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EPROTO The timedata file is improperly formatted.
+*/
+int byztime_get_real_offset(byztime_ctx *ctx, byztime_stamp *real_offset);
+
 /** Gets bounds and an estimate of the global time.
 
     \param[in] ctx Pointer to context object.
@@ -265,8 +766,281 @@ int byztime_get_offset(byztime_ctx *ctx, byztime_stamp *min, byztime_stamp *est,
 int byztime_get_global_time(byztime_ctx *ctx, byztime_stamp *min,
                             byztime_stamp *est, byztime_stamp *max);
 
+/** Gets bounds and an estimate of the global time from within a signal
+    handler.
+
+    This function is async-signal-safe: it takes no locks, allocates
+    nothing, does not touch thread-specific data and does not modify
+    `errno`, so it may be called from a signal handler, including one that
+    has interrupted another byztime call on the same thread. The only
+    system call it makes is `clock_gettime()`, which is served by the
+    vDSO on most platforms.
+
+    Since it must not modify `ctx`, it ignores any slewing set up by
+    byztime_slew() and returns the midpoint of the bounds as its estimate,
+    or the provider's estimate if it publishes a shared slew and
+    byztime_slew_shared() was called on `ctx`. Error bounds are the same as
+    those of byztime_get_global_time(). `ctx` must not be closed while a
+    call is in progress.
+
+    \param[in] ctx Pointer to context object.
+    \param[out] min Minimum possible global time.
+    \param[out] est Estimated global time.
+    \param[out] max Maximum possible global time.
+
+    \returns 0 on success.
+    \returns A positive `errno` value on failure. `errno` itself is left
+    unchanged.
+
+    \exception EPROTO The timedata file is improperly formatted, or was
+    truncated while being read.
+    \exception EOVERFLOW A result overflowed.
+
+    Any error that `clock_gettime()` may set can also be returned.
+*/
+int byztime_get_global_time_signal_safe(byztime_ctx const *ctx,
+                                        byztime_stamp *min,
+                                        byztime_stamp *est,
+                                        byztime_stamp *max);
+
+/** Gets bounds and an estimate of the global time, in nanoseconds.
+
+    This is a faster alternative to byztime_get_global_time() for callers
+    that can work with global time as a 64-bit count of nanoseconds. The
+    provider publishes, alongside each entry, a fixed-point linear map
+    from local time to global time of the same mult/shift form that the
+    kernel uses for its clocksources, so that this function costs one read
+    of the local clock, one 128-bit multiply, shift and add for the
+    estimate, and another for the error bound.
+
+    The estimate is the provider's: it follows the host-wide slew if the
+    provider is publishing one (see byztime_slew_shared()) and is the
+    midpoint of the bounds otherwise. Per-context slewing set up by
+    byztime_slew() is not applied. Error bounds account for drift exactly
+    as byztime_get_global_time() does, rounded outward by at most a
+    nanosecond.
+
+    If the provider does not publish a linear map, this function falls
+    back to the equivalent computation on timestamps.
+
+    \param[in] ctx Pointer to context object.
+    \param[out] min Minimum possible global time.
+    \param[out] est Estimated global time.
+    \param[out] max Maximum possible global time.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EPROTO The timedata file is improperly formatted.
+    \exception EOVERFLOW A result does not fit in 64 bits.
+
+    In addition to the above `errno` values, any error set by `clock_gettime()`
+    may be returned.
+*/
+int byztime_get_global_time_ns(byztime_ctx *ctx, int64_t *min, int64_t *est,
+                               int64_t *max);
+
+/** Opaque type of a set of per-CPU entry caches. */
+typedef struct byztime_percpu_s byztime_percpu;
+
+/** Creates a set of per-CPU entry caches for a context.
+
+    Every read of global time loads the current entry from the timedata
+    page, whose cache lines are shared by every reader on the host and
+    invalidated in all of their caches each time the provider publishes.
+    For threads which read the time at very high rates,
+    byztime_percpu_get_global_time_ns() instead computes from a private
+    copy of the entry kept for the CPU that the caller is running on,
+    refreshing the copy from the page once it is older than `refresh`.
+
+    Computing from a superseded entry is still correct: its error bounds
+    have been growing at the drift rate since it was published, so they
+    still contain global time, though they may be wider than those of the
+    current entry by up to the improvement in error that the provider
+    achieved in the meantime. Choose `refresh` accordingly.
+
+    The caches may be shared by any number of threads. `ctx` must outlive
+    them.
+
+    \param[in] ctx Pointer to context object.
+    \param[in] refresh Maximum age of a cached entry, measured in local
+    time from when it was copied.
+
+    \returns A pointer to the new caches on success.
+    \returns `NULL` on failure and sets `errno`.
+
+    \exception EINVAL `refresh` is not positive.
+*/
+byztime_percpu *byztime_percpu_new(byztime_ctx *ctx,
+                                   byztime_stamp const *refresh);
+
+/** Gets bounds and an estimate of the global time, in nanoseconds, using
+    per-CPU entry caches.
+
+    Results are as for byztime_get_global_time_ns() applied to an entry
+    at most the caches' refresh interval old.
+
+    \param[in] pc Pointer to caches created by byztime_percpu_new().
+    \param[out] min Minimum possible global time.
+    \param[out] est Estimated global time.
+    \param[out] max Maximum possible global time.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`, as for
+    byztime_get_global_time_ns().
+*/
+int byztime_percpu_get_global_time_ns(byztime_percpu *pc, int64_t *min,
+                                      int64_t *est, int64_t *max);
+
+/** Frees per-CPU entry caches. If `pc` is `NULL`, this is a no-op. */
+void byztime_percpu_free(byztime_percpu *pc);
+
+/** Gets the global time as of the provider's most recent tick.
+
+    If the provider is running a tick (see byztime_provider_start_tick()),
+    this is the global-time analogue of `CLOCK_REALTIME_COARSE`: it loads
+    the bounds and estimate that the provider last stored in a dedicated
+    cache line of the timedata file, and reads `CLOCK_MONOTONIC_COARSE`
+    to check that the tick isn't stale. The estimate lags true global time
+    by the age of the tick, normally up to a tick period. `min` is the
+    tick's. `max` is widened to cover the longest time that can have
+    passed since the tick, given its measured age, the resolution of
+    `CLOCK_MONOTONIC_COARSE` and the drift rate set on `ctx`.
+
+    The tick's bounds were computed using the provider's drift rate, not
+    the one set on `ctx`, and no slewing set up on `ctx` is applied.
+
+    \param[in] ctx Pointer to context object.
+    \param[out] min Minimum possible global time, in nanoseconds.
+    \param[out] est Estimated global time, in nanoseconds.
+    \param[out] max Maximum possible global time, in nanoseconds.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception ENODATA The provider isn't running a tick.
+    \exception ESTALE The most recent tick is more than four periods
+    old, probably because the provider has stopped.
+    \exception EPROTO The timedata file is improperly formatted.
+    \exception EOVERFLOW A result does not fit in 64 bits.
+*/
+int byztime_get_global_time_coarse(byztime_ctx const *ctx, int64_t *min,
+                                   int64_t *est, int64_t *max);
+
+/** Bounds and an estimate of a time or an offset. */
+typedef struct byztime_interval_s {
+  byztime_stamp min;
+  byztime_stamp est;
+  byztime_stamp max;
+} byztime_interval;
+
+/** Gets bounds and an estimate of the global time for several contexts at
+    once.
+
+    The local clock is read once, and each context's current entry is
+    then applied to that same reading, so the results describe a single
+    instant and are mutually consistent. This is useful to processes which
+    follow several timedata files, such as for different time domains or
+    providers, and costs one clock read plus one entry load per context
+    rather than a clock read per context. Each context's slew mode is
+    honored as in byztime_get_global_time().
+
+    \param[in] ctx Array of `n` pointers to context objects.
+    \param[in] n Number of contexts.
+    \param[out] out Array of `n` intervals, the `k`th of which receives
+    the global time according to `ctx[k]`.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`. Processing stops at the
+    first context for which an error occurs, and the contents of `out`
+    are unspecified.
+
+    \exception EPROTO A timedata file is improperly formatted.
+    \exception EOVERFLOW An integer underflow/overflow occurred during
+    time or error computation.
+
+    In addition to the above `errno` values, any error set by `clock_gettime()`
+    may be returned.
+*/
+int byztime_get_global_time_multi(byztime_ctx *const ctx[], size_t n,
+                                  byztime_interval out[]);
+
+/** Gets bounds and an estimate of the global time elapsed since a local
+    time.
+
+    Subtracting two results of byztime_get_global_time() to measure a
+    duration adds together both of their error bounds, which reflect
+    the uncertainty of the offset at each moment. But the uncertainty
+    of the duration itself comes only from the local clock's drift over
+    it. This function therefore reads only the local clock, not the
+    timedata file, and bounds the elapsed global time `d` between
+    `start_local` and now as `d * (1 +/- drift)`, using the drift rate
+    set with byztime_set_drift().
+
+    \param[in] ctx Pointer to context object, consulted only for its
+    drift rate.
+    \param[in] start_local The local time at the start of the interval,
+    as returned by byztime_get_local_time().
+    \param[out] min Minimum possible elapsed global time.
+    \param[out] est Estimated elapsed global time.
+    \param[out] max Maximum possible elapsed global time.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EOVERFLOW An integer underflow/overflow occurred.
+
+    In addition to the above `errno` values, any error set by `clock_gettime()`
+    may be returned.
+*/
+int byztime_elapsed(byztime_ctx const *ctx, byztime_stamp const *start_local,
+                    byztime_stamp *min, byztime_stamp *est,
+                    byztime_stamp *max);
+
+/** A stopwatch which measures elapsed global time from the local clock.
+    See byztime_stopwatch_start(). */
+typedef struct byztime_stopwatch_s {
+  /** Local time at which the stopwatch was started. */
+  byztime_stamp start;
+  /** Drift rate used to bound readings, in parts per billion. */
+  int64_t drift_ppb;
+} byztime_stopwatch;
+
+/** Starts a stopwatch.
+
+    Records the current local time and the drift rate of `ctx`, so that
+    byztime_stopwatch_read() can later bound the elapsed global time
+    exactly as byztime_elapsed() does, without needing `ctx`.
+
+    \param[in] ctx Pointer to context object, consulted only for its
+    drift rate.
+    \param[out] stopwatch The stopwatch to start.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+*/
+int byztime_stopwatch_start(byztime_ctx const *ctx,
+                            byztime_stopwatch *stopwatch);
+
+/** Reads a stopwatch.
+
+    \param[in] stopwatch A stopwatch started with
+    byztime_stopwatch_start().
+    \param[out] min Minimum possible elapsed global time.
+    \param[out] est Estimated elapsed global time.
+    \param[out] max Maximum possible elapsed global time.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno` as for byztime_elapsed().
+*/
+int byztime_stopwatch_read(byztime_stopwatch const *stopwatch,
+                           byztime_stamp *min, byztime_stamp *est,
+                           byztime_stamp *max);
+
 /** Sets the drift rate used in error calculations.
 
+    Has no effect on the context returned by byztime_default_ctx().
+
     \param[in] ctx Pointer to context object.
     \param[in] drift_ppb Drift rate in parts per billion.
 */
@@ -278,6 +1052,28 @@ void byztime_set_drift(byztime_ctx *ctx, int64_t drift_ppb);
 */
 int64_t byztime_get_drift(byztime_ctx const *ctx);
 
+/** Chooses whether to use the provider's measured drift bound.
+
+    By default, error bounds grow with the age of the latest measurement
+    at the rate set by byztime_set_drift(), which defaults to a
+    deliberately pessimistic 250 parts per million. If `enable` is
+    non-zero, they instead grow at the rate which the provider measured
+    from its own history of offsets, as set up by
+    byztime_provider_estimate_drift(), whenever one is available. The
+    rate set by byztime_set_drift() remains in use as a fallback.
+
+    \param[in] ctx Pointer to context object.
+    \param[in] enable Non-zero to use the measured drift bound, zero to
+    use only the rate set by byztime_set_drift().
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EPERM `ctx` is the shared context returned by
+    byztime_default_ctx().
+*/
+int byztime_use_measured_drift(byztime_ctx *ctx, int enable);
+
 /** Begin slewing time estimates.
 
     This function changes how `est` is calcuated in future calls to
@@ -326,6 +1122,8 @@ int64_t byztime_get_drift(byztime_ctx const *ctx);
     \returns -1 on failure and sets `errno`.
 
     \exception ERANGE The current time is not known to within `maxerror`.
+    \exception EPERM `ctx` is the shared context returned by
+    byztime_default_ctx().
 */
 int byztime_slew(byztime_ctx *ctx, int64_t min_rate_ppb, int64_t max_rate_ppb,
                  byztime_stamp const *maxerror);
@@ -342,12 +1140,41 @@ int byztime_slew(byztime_ctx *ctx, int64_t min_rate_ppb, int64_t max_rate_ppb,
 */
 int byztime_step(byztime_ctx *ctx);
 
-#if defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 199309L
-/** Install a signal handler for graceful recovery from page faults in the
-   timedata file.
+/** Follow the host-wide slewed estimate published by the provider.
 
-    If the timedata file gets truncated after it has been opened,
-    future accesses to it will raise SIGBUS. This function installs a
+    Where byztime_slew() runs a separate slew computation in every
+    context, so that two processes on the same host can report
+    different estimates, this function makes `ctx` use the slewed
+    offset which the provider computes once, as set up by
+    byztime_provider_slew(), and publishes alongside each entry.
+    Every context in this mode therefore reports the same monotone
+    estimate, and evaluating it costs a single multiply-add. Because
+    no per-context state is involved, the estimate is also unaffected
+    by how often or how rarely `ctx` is read.
+
+    If the provider is not publishing a slewed offset, estimates are
+    computed exactly as in step mode. The bounds `min` and `max` are
+    unaffected by slewing, and as with byztime_slew(), `est` may
+    occasionally fall outside of them.
+
+    Calling byztime_slew() or byztime_step() leaves this mode.
+
+    \param[in] ctx Pointer to context object.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EPERM `ctx` is the shared context returned by
+    byztime_default_ctx().
+*/
+int byztime_slew_shared(byztime_ctx *ctx);
+
+#if defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 199309L
+/** Install a signal handler for graceful recovery from page faults in the
+   timedata file.
+
+    If the timedata file gets truncated after it has been opened,
+    future accesses to it will raise SIGBUS. This function installs a
     signal handler that will allow whatever function was trying to
     access the truncated file to gracefully error out with EPROTO
     rather than crashing the program. If the SIGBUS was caused for any
@@ -397,6 +1224,165 @@ int byztime_install_sigbus_handler(struct sigaction *oact);
 void byztime_handle_sigbus(int signo, siginfo_t *info, void *context);
 #endif
 
+/** @} */
+/** \defgroup clock Conversion from other clocks
+    @{
+*/
+
+#if defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 199309L
+/** Samples a clock against local time.
+
+    Converting a timestamp from another clock relies on a history of
+    samples, each pairing a reading of that clock with local
+    (`CLOCK_MONOTONIC_RAW`) readings taken immediately before and after
+    it; of several attempts, the one with the closest-together local
+    readings is kept. The conversion functions below take a new sample
+    themselves whenever the newest is more than 100 milliseconds old, so
+    calling this function is never necessary, but a program which
+    converts timestamps in bursts can call it periodically to keep the
+    history dense and the conversions tight.
+
+    The history is process-wide and shared by all threads.
+
+    \param[in] clock One of `CLOCK_REALTIME`, `CLOCK_MONOTONIC`,
+    `CLOCK_BOOTTIME`, `CLOCK_TAI` or `CLOCK_MONOTONIC_RAW` (for which
+    this function does nothing).
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `clock` is not supported.
+
+    This function is declared conditionally upon `defined(_POSIX_C_SOURCE) &&
+   _POSIX_C_SOURCE >= 199309L`.
+*/
+int byztime_clock_calibrate(clockid_t clock);
+
+/** Converts a timestamp from another clock into global time.
+
+    The timestamp is first converted into local time by interpolating
+    between, or extrapolating from, the samples described under
+    byztime_clock_calibrate(). Its bounds take into account each
+    sample's uncertainty and the largest rate difference between the
+    clocks which the kernel permits: 1000 parts per million for its NTP
+    discipline, plus however far the tick length had been adjusted from
+    nominal (`ADJ_TICK`) when the samples were taken. The result is
+    then converted into global time using the current entry exactly as
+    byztime_get_global_time() would at that local time, with error
+    growing in both directions from the entry's measurement time. The
+    estimate is unslewed unless `ctx` is in byztime_slew_shared() mode.
+
+    Bounds are only valid if `clock` has not been stepped between the
+    time of `ts` and the time of the samples used to convert it. The
+    calibrator detects steps and discards samples taken before them, so
+    that timestamps taken after a step convert correctly.
+
+    \param[in] ctx Pointer to context object.
+    \param[in] clock The clock which `ts` was read from. Supported clocks
+    are as for byztime_clock_calibrate().
+    \param[in] ts The timestamp to convert.
+    \param[out] min Minimum possible global time.
+    \param[out] est Estimated global time.
+    \param[out] max Maximum possible global time.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `clock` is not supported.
+    \exception EPROTO The timedata file is improperly formatted.
+    \exception EOVERFLOW An integer underflow/overflow occurred.
+
+    This function is declared conditionally upon `defined(_POSIX_C_SOURCE) &&
+   _POSIX_C_SOURCE >= 199309L`.
+*/
+int byztime_convert_from_clock(byztime_ctx *ctx, clockid_t clock,
+                               byztime_stamp const *ts, byztime_stamp *min,
+                               byztime_stamp *est, byztime_stamp *max);
+
+/** Converts an array of timestamps from another clock into global time.
+
+    This is equivalent to calling byztime_convert_from_clock() on each
+    element of `ts`, except that the calibration history and the timedata
+    entry are each loaded only once.
+
+    \param[in] ctx Pointer to context object.
+    \param[in] clock The clock which `ts` was read from.
+    \param[in] ts Array of `n` timestamps to convert.
+    \param[in] n Number of timestamps.
+    \param[out] out Array of `n` intervals to receive the results.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`, which may take any value
+    listed for byztime_convert_from_clock().
+
+    This function is declared conditionally upon `defined(_POSIX_C_SOURCE) &&
+   _POSIX_C_SOURCE >= 199309L`.
+*/
+int byztime_convert_from_clock_batch(byztime_ctx *ctx, clockid_t clock,
+                                     byztime_stamp const ts[], size_t n,
+                                     byztime_interval out[]);
+#endif
+
+/** @} */
+/** \defgroup net Network timestamps
+    @{
+*/
+
+struct mmsghdr;
+struct timespec;
+
+/** Enables kernel software receive timestamps on a socket.
+
+    This sets the `SO_TIMESTAMPING` socket option with
+    `SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE`, which
+    byztime_recvmmsg() needs in order to stamp datagrams.
+
+    \param[in] sockfd The socket.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+*/
+int byztime_enable_rx_timestamps(int sockfd);
+
+/** Receives a batch of datagrams and stamps each with global time.
+
+    This wraps `recvmmsg()`, taking the same arguments plus `stamps`, an
+    array parallel to `msgvec`. For each datagram received, the kernel's
+    software receive timestamp, as enabled by
+    byztime_enable_rx_timestamps() or by `SO_TIMESTAMPNS`, is converted
+    into global time exactly as byztime_convert_from_clock() would
+    convert a `CLOCK_REALTIME` timestamp, except that a single
+    calibration snapshot and a single timedata entry serve the whole
+    batch. Because the timestamp is taken in the kernel when the
+    datagram arrives, it includes neither the cost of a separate
+    byztime_get_global_time() call nor any delay in scheduling the
+    receiving thread.
+
+    Each `msgvec[k].msg_hdr` must provide a control buffer large enough
+    for the timestamp, such as
+    `CMSG_SPACE(3 * sizeof(struct timespec))` bytes.
+
+    If a datagram carries no timestamp, or its timestamp cannot be
+    converted, the corresponding element of `stamps` is set to all
+    zeroes. The datagrams are returned regardless, since they have
+    already been consumed from the socket.
+
+    \param[in] ctx Pointer to context object.
+    \param[in] sockfd The socket to receive from.
+    \param[in,out] msgvec As for `recvmmsg()`.
+    \param[in] vlen As for `recvmmsg()`.
+    \param[in] flags As for `recvmmsg()`.
+    \param[in] timeout As for `recvmmsg()`.
+    \param[out] stamps Array of at least `vlen` intervals, the `k`th of
+    which receives the global time at which the `k`th datagram arrived.
+
+    \returns The number of datagrams received.
+    \returns -1 on failure and sets `errno` as `recvmmsg()` does.
+*/
+int byztime_recvmmsg(byztime_ctx *ctx, int sockfd, struct mmsghdr *msgvec,
+                     unsigned int vlen, int flags, struct timespec *timeout,
+                     byztime_interval stamps[]);
+
 /** @} */
 /** \defgroup provider Provider API
     @{
@@ -411,6 +1397,71 @@ void byztime_handle_sigbus(int signo, siginfo_t *info, void *context);
 */
 byztime_ctx *byztime_open_rw(char const *pathname);
 
+/** Opens a timedata file as a hot standby for the provider that owns it.
+
+    A standby context is mapped read-write and prefaulted, and has the
+    lock file open, but does not take the lock. Until
+    byztime_standby_takeover() succeeds, it may be used for reading
+    global time and for configuring provider options such as
+    byztime_provider_slew() and byztime_provider_estimate_drift(), but
+    byztime_set_offset() and byztime_update_real_offset() fail with
+    `EPERM`.
+
+    \param[in] pathname The path to a timedata file initialized by a
+    running provider.
+
+    \return A pointer to a newly-allocated context object, or `NULL` on
+    failure and sets `errno`.
+
+    \exception EPROTO `pathname` is not a correctly-formatted timedata
+    file, or lacks the extension region that this version of the library
+    writes.
+    \exception ECONNREFUSED The timedata file's era does not match the
+    current boot.
+*/
+byztime_ctx *byztime_open_standby(char const *pathname);
+
+/** Keeps a standby context warm.
+
+    Feeds the primary provider's latest entry, if it hasn't been seen
+    already, into the standby's drift estimator and `CLOCK_MONOTONIC`
+    rate measurement, so that they carry on without a gap after a
+    takeover. Calling this once per publication interval or so is
+    enough; entries missed in between are harmless.
+
+    \param[in] ctx Pointer to a context opened with byztime_open_standby().
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `ctx` is not a standby context.
+    \exception EPROTO The timedata file is improperly formatted.
+*/
+int byztime_standby_poll(byztime_ctx *ctx);
+
+/** Takes over publishing from the primary provider.
+
+    Acquires the lock file, which happens as soon as the primary exits or
+    dies, re-initializes the mutex inside the timedata file exactly as
+    byztime_open_rw() does, and absorbs the primary's final entry. The
+    context then behaves as if it had been opened with byztime_open_rw(),
+    except that the timedata file keeps all of the primary's entries, so
+    consumers see no discontinuity.
+
+    \param[in] ctx Pointer to a context opened with byztime_open_standby().
+    \param[in] block If non-zero, wait for the primary to release the
+    lock. Otherwise fail immediately if it still holds it.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `ctx` is not a standby context.
+    \exception EWOULDBLOCK `block` is zero and the primary still holds
+    the lock.
+    \exception EINTR The wait was interrupted by a signal.
+*/
+int byztime_standby_takeover(byztime_ctx *ctx, int block);
+
 /** Sets the time offset `(global time - local time)` and error bound.
 
     \param[in] ctx Pointer to context object.
@@ -425,6 +1476,172 @@ byztime_ctx *byztime_open_rw(char const *pathname);
 int byztime_set_offset(byztime_ctx *ctx, byztime_stamp const *offset,
                        byztime_stamp const *error, byztime_stamp const *as_of);
 
+/** Publishes a new offset and real_offset together.
+
+    This is equivalent to byztime_set_offset() followed by
+    byztime_update_real_offset(), except that both are written within a
+    single critical section and become visible to consumers at once,
+    with one update of the current entry, and that `real_offset` is
+    computed from the new offset rather than by a separate
+    byztime_get_global_time().
+
+    Every entry published by this library version carries a copy of the
+    real_offset in force when it was published, which consumers can read
+    with byztime_get_real_offset(). If coalescing is enabled (see
+    byztime_provider_coalesce()) and the entry is skipped, `real_offset`
+    is still updated in the header, but consumers won't see it until the
+    next entry is published.
+
+    \param[in] ctx Pointer to the context object.
+    \param[in] offset As for byztime_set_offset().
+    \param[in] error As for byztime_set_offset().
+    \param[in] as_of As for byztime_set_offset().
+    \param[in] real_offset The difference between global time and real
+    time to record, or `NULL` to compute it from `offset` and the current
+    real and local time.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+*/
+int byztime_publish(byztime_ctx *ctx, byztime_stamp const *offset,
+                    byztime_stamp const *error, byztime_stamp const *as_of,
+                    byztime_stamp const *real_offset);
+
+/** Begin publishing a slewed offset estimate for consumers to share.
+
+    After this call, each call to byztime_set_offset() publishes, along
+    with the new offset, a piecewise-linear correction that carries the
+    estimate seen by consumers in byztime_slew_shared() mode from its
+    previously-published value to the new offset at the fastest rate
+    permitted by `min_rate_ppb` and `max_rate_ppb`, whose meaning is as
+    for byztime_slew(). Consumers not in that mode are unaffected.
+
+    As with byztime_slew(), a maximum rate of `INT64_MAX` is treated as
+    infinity, so forward corrections are applied as a step.
+
+    \param[in] ctx Pointer to a context opened with byztime_open_rw().
+    \param[in] min_rate_ppb Minimum clock rate in parts per billion.
+    Must be between 0 and 1000000000 inclusive.
+    \param[in] max_rate_ppb Maximum clock rate in parts per billion.
+    Must be at least 1000000000.
+    \param[in] maxerror Maximum error bound for slew mode to be
+    allowed to take effect. May be `NULL`.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL A rate is out of range.
+    \exception ERANGE The current offset is not known to within `maxerror`.
+*/
+int byztime_provider_slew(byztime_ctx *ctx, int64_t min_rate_ppb,
+                          int64_t max_rate_ppb, byztime_stamp const *maxerror);
+
+/** Stop publishing a slewed offset estimate.
+
+    Offsets published after this call are applied by consumers in
+    byztime_slew_shared() mode as a step.
+
+    \param[in] ctx Pointer to a context opened with byztime_open_rw().
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+*/
+int byztime_provider_step(byztime_ctx *ctx);
+
+/** Begin estimating local oscillator drift from published offsets.
+
+    After this call, each call to byztime_set_offset() also records its
+    arguments in a short history and publishes a conservative bound on
+    the drift of the local clock, derived from how much the offset can
+    have changed between measurements given their error bounds. Of the
+    bounds implied by pairs of measurements, the largest is published,
+    so that it covers the fastest drift seen anywhere in the window. The
+    bound is only published once the history spans a quarter of
+    `window`, and it is never less than 1 part per million. Consumers
+    opt into using it with byztime_use_measured_drift().
+
+    \param[in] ctx Pointer to a context opened with byztime_open_rw().
+    \param[in] window The span of local time over which to retain
+    measurements, or `NULL` to stop estimating. Longer windows give
+    tighter bounds but adapt more slowly to changes in drift.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `window` is not positive.
+*/
+int byztime_provider_estimate_drift(byztime_ctx *ctx,
+                                    byztime_stamp const *window);
+
+/** Skip publishing offsets that wouldn't tell consumers anything new.
+
+    Each byztime_set_offset() rewrites an entry and invalidates every
+    consumer's cached copy of the timedata page. After this call,
+    byztime_set_offset() returns successfully without publishing when the
+    previously-published entry is still conservative with respect to the
+    new measurement, that is, when the old bounds contain the new ones and
+    therefore always will, and additionally:
+
+    - the offset has changed by less than `threshold`,
+    - the error has shrunk by less than `threshold`, and
+    - the published entry's `as_of` is less than `max_interval` older than
+      the new one's.
+
+    Skipped measurements still feed the drift estimator enabled by
+    byztime_provider_estimate_drift().
+
+    \param[in] ctx Pointer to a context opened with byztime_open_rw().
+    \param[in] threshold Change in offset or error at or above which a
+    measurement is always published. May be `NULL` to disable coalescing.
+    \param[in] max_interval Maximum age of the published entry before a
+    new measurement is published regardless. May be `NULL` to disable
+    coalescing.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL An argument is negative.
+    \exception EOVERFLOW An argument does not fit in 64 bits of
+    nanoseconds.
+*/
+int byztime_provider_coalesce(byztime_ctx *ctx, byztime_stamp const *threshold,
+                              byztime_stamp const *max_interval);
+
+/** Reports how many calls to byztime_set_offset() have been published and
+    how many were skipped since byztime_provider_coalesce() was last
+    called. Either pointer may be `NULL`. */
+void byztime_provider_coalesce_stats(byztime_ctx const *ctx,
+                                     uint64_t *published, uint64_t *saved);
+
+/** Starts publishing a coarse global-time tick.
+
+    Starts a thread which every `period` computes the global time, as
+    byztime_get_global_time_ns() would on `ctx`, and stores it in a
+    dedicated cache line of the timedata file, from which any consumer on
+    the host can read it with byztime_get_global_time_coarse(). If a tick
+    is already running, it is restarted with the new period. The tick is
+    stopped by byztime_provider_stop_tick() or byztime_close().
+
+    \param[in] ctx Pointer to a context opened with byztime_open_rw().
+    \param[in] period Interval between ticks.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `period` is not positive.
+    \exception EPERM `ctx` is a standby context that has not taken over.
+*/
+int byztime_provider_start_tick(byztime_ctx *ctx,
+                                byztime_stamp const *period);
+
+/** Stops the tick started by byztime_provider_start_tick(), if any, and
+    marks it as not running in the timedata file.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+*/
+int byztime_provider_stop_tick(byztime_ctx *ctx);
+
 /** Gets the offset without any slewing or error calculation. */
 void byztime_get_offset_quick(byztime_ctx const *ctx, byztime_stamp *offset);
 
@@ -436,7 +1653,9 @@ void byztime_get_offset_raw(byztime_ctx const *ctx, byztime_stamp *offset,
 /** Recompute and record the difference between global time and real time.
 
     This is used to recover a best-guess `(global_time - local_time)` offset
-    after the next reboot.
+    after the next reboot. The current entry is republished unchanged
+    along with the new value, so that consumers see it through
+    byztime_get_real_offset() at once.
 
     \param[in] ctx Pointer to the context object.
     \returns 0 on success.
@@ -444,6 +1663,422 @@ void byztime_get_offset_raw(byztime_ctx const *ctx, byztime_stamp *offset,
 */
 int byztime_update_real_offset(byztime_ctx *ctx);
 
+/** @} */
+/** \defgroup latency One-way latency
+    @{
+*/
+
+/** Computes bounds on the one-way latency of a message.
+
+    Given intervals of global time at which a message was sent and
+    received, typically obtained from byztime_get_global_time() on two
+    different hosts, computes `latency->min = max(0, recv->min -
+    send->max)` and `latency->max = recv->max - send->min`. The estimate
+    is `recv->est - send->est`, clamped to lie within those bounds.
+
+    \param[out] latency The latency.
+    \param[in] send Global time at which the message was sent.
+    \param[in] recv Global time at which the message was received.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EDOM `recv->max` is earlier than `send->min`, so the two
+    intervals cannot both be correct.
+    \exception EOVERFLOW The latency is not representable.
+*/
+int byztime_latency(byztime_interval *latency, byztime_interval const *send,
+                    byztime_interval const *recv);
+
+/** Computes bounds on the one-way latency of many messages.
+
+    Equivalent to calling byztime_latency() for each `k` less than `n`,
+    except that a failure does not stop processing: the failing output
+    is zeroed and the rest are still computed.
+
+    \returns 0 on success.
+    \returns -1 if any sample failed, and sets `errno` to the error of
+    the first such sample.
+*/
+int byztime_latency_batch(byztime_interval latency[],
+                          byztime_interval const send[],
+                          byztime_interval const recv[], size_t n);
+
+/** Opaque type of a streaming latency aggregate. */
+typedef struct byztime_latency_stats_s byztime_latency_stats;
+
+/** Creates an empty latency aggregate.
+
+    An aggregate accumulates latency intervals such as those computed by
+    byztime_latency() and reports their count, mean and quantiles as
+    intervals of their own. Because each sample's true latency lies
+    within its bounds, the true mean and true quantiles lie within the
+    reported bounds. Quantiles are computed from histograms with
+    about 3% relative resolution, which the reported bounds also
+    account for.
+
+    Aggregates are not thread-safe. Threads should each keep their own
+    and combine them with byztime_latency_stats_merge().
+
+    \returns A pointer to the new aggregate on success.
+    \returns `NULL` on failure and sets `errno`.
+*/
+byztime_latency_stats *byztime_latency_stats_new(void);
+
+/** Frees a latency aggregate. If `stats` is `NULL`, this is a no-op. */
+void byztime_latency_stats_free(byztime_latency_stats *stats);
+
+/** Empties a latency aggregate. */
+void byztime_latency_stats_reset(byztime_latency_stats *stats);
+
+/** Adds a sample to a latency aggregate.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL The sample is not a valid latency: its minimum is
+    negative, or its estimate is outside its bounds.
+    \exception EOVERFLOW The sample is not representable as 64 bits of
+    nanoseconds.
+*/
+int byztime_latency_stats_add(byztime_latency_stats *stats,
+                              byztime_interval const *latency);
+
+/** Adds `n` samples to a latency aggregate.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`. Samples before the failing
+    one have been added, and those after it have not.
+*/
+int byztime_latency_stats_add_batch(byztime_latency_stats *stats,
+                                    byztime_interval const latency[],
+                                    size_t n);
+
+/** Adds all of the samples in `src` to `dst`. */
+void byztime_latency_stats_merge(byztime_latency_stats *dst,
+                                 byztime_latency_stats const *src);
+
+/** Returns the number of samples in a latency aggregate. */
+uint64_t byztime_latency_stats_count(byztime_latency_stats const *stats);
+
+/** Gets the mean of the samples in a latency aggregate.
+
+    \param[in] stats The aggregate.
+    \param[out] mean The means of the samples' minima, estimates, and
+    maxima.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception ENODATA The aggregate is empty.
+*/
+int byztime_latency_stats_mean(byztime_latency_stats const *stats,
+                               byztime_interval *mean);
+
+/** Gets a quantile of the samples in a latency aggregate.
+
+    \param[in] stats The aggregate.
+    \param[in] q The quantile, between 0 and 1 inclusive. For example,
+    0.99 gives the 99th percentile.
+    \param[out] quantile Bounds on the `q` quantile of the samples' true
+    latencies, and an estimate of it.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL `q` is out of range.
+    \exception ENODATA The aggregate is empty.
+*/
+int byztime_latency_stats_quantile(byztime_latency_stats const *stats,
+                                   double q, byztime_interval *quantile);
+
+/** @} */
+/** \defgroup leap Leap seconds and time scales
+    @{
+*/
+
+/** Opaque type of a leap second table. */
+typedef struct byztime_leap_table_s byztime_leap_table;
+
+/** Global time, as returned by byztime_get_global_time(). */
+#define BYZTIME_TIMESCALE_GLOBAL 0
+/** UTC as counted by POSIX `CLOCK_REALTIME`, which omits leap
+    seconds. */
+#define BYZTIME_TIMESCALE_UTC 1
+/** International Atomic Time, counted in seconds since 1970-01-01
+    00:00:00 TAI. */
+#define BYZTIME_TIMESCALE_TAI 2
+/** UTC with each leap second spread linearly over a window centred on
+    it. */
+#define BYZTIME_TIMESCALE_SMEARED 3
+
+/** Leap second list shipped with most tzdata packages. */
+#define BYZTIME_LEAP_SECONDS_PATH "/usr/share/zoneinfo/leap-seconds.list"
+
+/** Recommended smear window, 24 hours, which spreads each leap second
+    from noon to noon UTC. */
+#define BYZTIME_LEAP_SMEAR_DEFAULT (86400LL * 1000000000LL)
+
+/** Loads a leap second table.
+
+    \param[in] path A file in the format of IERS/NIST `leap-seconds.list`,
+    such as `BYZTIME_LEAP_SECONDS_PATH`. Its expiration date, from the
+    `#@` line, is available from byztime_leap_expires(). The file's hash
+    is not verified.
+    \param[in] smear The window over which each leap second is smeared
+    for `BYZTIME_TIMESCALE_SMEARED`, in nanoseconds. Must be more than 2
+    seconds and at most 30 days.
+
+    \returns A pointer to the table on success.
+    \returns `NULL` on failure and sets `errno`.
+
+    \exception EINVAL `smear` is out of range.
+    \exception EPROTO The file is malformed, has no expiration date, or
+    has leap seconds closer together than `smear`.
+
+    In addition, any error set by `fopen()` or `getline()` may be
+    returned.
+*/
+byztime_leap_table *byztime_leap_load(char const *path, int64_t smear);
+
+/** Frees a leap second table. If `table` is `NULL`, this is a no-op. */
+void byztime_leap_free(byztime_leap_table *table);
+
+/** Gets the expiration date of a leap second table.
+
+    Conversions past this date assume no further leap seconds, which
+    may turn out to be wrong. Callers should reload the table from an
+    updated file before it expires.
+
+    \param[in] table The table.
+    \param[out] expires The expiration date, in `BYZTIME_TIMESCALE_UTC`.
+*/
+void byztime_leap_expires(byztime_leap_table const *table,
+                          byztime_stamp *expires);
+
+/** Converts a timestamp between time scales.
+
+    Each table remembers which of its segments was used most recently
+    and tries that one first. A stream of nearby timestamps is therefore
+    converted in constant time, without searching. Tables may be shared
+    between threads.
+
+    An inserted leap second has no POSIX time of its own. TAI or smeared
+    times within it convert to UTC as the following second, which
+    therefore occurs twice. Times before the first entry in the table
+    use that entry's TAI - UTC offset.
+
+    \param[in] table The table.
+    \param[in] to_scale The time scale to convert to, one of the
+    `BYZTIME_TIMESCALE_*` constants.
+    \param[out] out The converted timestamp.
+    \param[in] from_scale The time scale to convert from.
+    \param[in] in The timestamp to convert.
+    \param[in] real_offset Global time minus UTC, as returned by
+    byztime_get_real_offset(). It is needed only when one of the scales
+    is `BYZTIME_TIMESCALE_GLOBAL`, and may be `NULL` otherwise.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EINVAL A time scale is invalid, or `real_offset` is `NULL`
+    but needed.
+    \exception EOVERFLOW The timestamp, as UTC, is not representable as
+    64 bits of nanoseconds, so falls outside the years 1678 to 2262.
+*/
+int byztime_leap_convert(byztime_leap_table const *table, int to_scale,
+                         byztime_stamp *out, int from_scale,
+                         byztime_stamp const *in,
+                         byztime_stamp const *real_offset);
+
+/** Converts `n` timestamps between time scales.
+
+    Equivalent to calling byztime_leap_convert() on each element of `in`
+    with the same other arguments. Converting timestamps in roughly
+    chronological order makes best use of the segment cache.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`. Elements before the failing
+    one have been converted, and those after it have not.
+*/
+int byztime_leap_convert_batch(byztime_leap_table const *table, int to_scale,
+                               byztime_stamp out[], int from_scale,
+                               byztime_stamp const in[], size_t n,
+                               byztime_stamp const *real_offset);
+
+/** @} */
+/** \defgroup wire Wire encoding
+    @{
+*/
+
+/** Version byte at the start of every encoded batch. */
+#define BYZTIME_WIRE_VERSION 1
+
+/** An upper bound on the size of a batch of `n` encoded intervals. */
+#define BYZTIME_WIRE_MAX_LEN(n) (26 + 30 * (size_t)(n))
+
+/** Encodes a batch of intervals.
+
+    The encoding is compact and canonical. The first estimate is taken as
+    a base, and each interval is written as three variable-length
+    integers: its estimate's distance from the base, and each bound's
+    distance from the estimate, all in nanoseconds. Intervals from a
+    single host and a short period therefore take a few bytes each
+    rather than 48. The encoding is independent of byte order.
+
+    \param[out] buf The output buffer.
+    \param[in] size Size of `buf`. `BYZTIME_WIRE_MAX_LEN(n)` bytes is
+    always enough.
+    \param[out] len The number of bytes written.
+    \param[in] in The intervals to encode.
+    \param[in] n Number of intervals.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception ENOBUFS `buf` is too small.
+    \exception EOVERFLOW An estimate differs from the first by more than
+    about 292 years, or a bound from its estimate by as much.
+*/
+int byztime_wire_encode(unsigned char *buf, size_t size, size_t *len,
+                        byztime_interval const in[], size_t n);
+
+/** Decodes a batch of intervals encoded by byztime_wire_encode().
+
+    The decoded stamps are normalized, and are otherwise exactly those
+    that were encoded.
+
+    \param[out] out Array of `cap` intervals to receive the batch.
+    \param[in] cap Capacity of `out`.
+    \param[out] n Number of intervals in the batch. This is set on
+    `ENOBUFS` too, so that a caller can learn how large `out` must be.
+    \param[in] buf The encoded batch.
+    \param[in] size Number of bytes available in `buf`, which may be
+    more than the batch occupies.
+    \param[out] consumed Number of bytes the batch occupied. May be
+    `NULL`.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception ENOBUFS The batch holds more than `cap` intervals.
+    \exception EPROTO The batch is truncated or malformed, or was encoded
+    by an incompatible version.
+    \exception EOVERFLOW A decoded stamp is not representable.
+*/
+int byztime_wire_decode(byztime_interval out[], size_t cap, size_t *n,
+                        unsigned char const *buf, size_t size,
+                        size_t *consumed);
+
+/** @} */
+/** \defgroup rt Real-time publishing
+    @{
+*/
+
+/** Opaque type of a real-time publisher. */
+typedef struct byztime_rt_publisher_s byztime_rt_publisher;
+
+/** Flag for byztime_rt_start(): lock all of the process's current and
+    future memory with `mlockall()`. */
+#define BYZTIME_RT_MLOCKALL 1
+
+/** Number of buckets in byztime_rt_stats::latency_hist. */
+#define BYZTIME_RT_HIST_BUCKETS 64
+
+/** Counters kept by a real-time publisher. */
+typedef struct byztime_rt_stats_s {
+  /** Offsets accepted by byztime_rt_enqueue(). */
+  uint64_t enqueued;
+  /** Offsets rejected by byztime_rt_enqueue() because the queue was
+      full. */
+  uint64_t dropped;
+  /** Offsets published. */
+  uint64_t published;
+  /** Offsets skipped because a newer one was already waiting. */
+  uint64_t superseded;
+  /** Offsets for which byztime_set_offset() failed. */
+  uint64_t failed;
+  /** `errno` from the most recent failure, or 0. */
+  int last_error;
+  /** Histogram of publication latency, measured from the call to
+      byztime_rt_enqueue() until the new entry is visible to consumers.
+      Bucket `k` counts latencies of at least 2<sup>k</sup> and less than
+      2<sup>k+1</sup> nanoseconds; bucket 0 also counts latencies under
+      one nanosecond. */
+  uint64_t latency_hist[BYZTIME_RT_HIST_BUCKETS];
+} byztime_rt_stats;
+
+/** Starts a thread that publishes offsets on behalf of the caller.
+
+    Any delay in byztime_set_offset() becomes error that consumers have to
+    absorb, so a provider whose measurement thread is subject to page
+    faults, priority inversion or preemption can instead hand each new
+    offset to byztime_rt_enqueue(). That places it in a lock-free
+    single-producer, single-consumer queue and wakes a dedicated thread
+    which calls byztime_set_offset() for it. If several offsets are
+    waiting when the publisher wakes, only the newest is published.
+
+    While the publisher is running, it is the only thread that may call
+    byztime_set_offset() or other provider functions on `ctx`, and `ctx`
+    must not be closed.
+
+    \param[in] ctx Pointer to a context opened with byztime_open_rw().
+    \param[in] cpu CPU to pin the publisher to, or -1 to leave its
+    affinity alone.
+    \param[in] priority `SCHED_FIFO` priority for the publisher, or 0 to
+    have it inherit the caller's scheduling policy.
+    \param[in] flags Zero or `BYZTIME_RT_MLOCKALL`. Memory locked this way
+    stays locked after byztime_rt_stop().
+
+    \returns A pointer to the new publisher on success.
+    \returns `NULL` on failure and sets `errno`.
+
+    \exception EINVAL An argument is out of range.
+    \exception EPERM The caller is not allowed to set the requested
+    scheduling policy or affinity.
+
+    In addition to the above `errno` values, any error set by `mlockall()`
+    or `pthread_create()` may be returned.
+*/
+byztime_rt_publisher *byztime_rt_start(byztime_ctx *ctx, int cpu, int priority,
+                                       int flags);
+
+/** Queues an offset for publication.
+
+    Arguments are as for byztime_set_offset(). A `NULL` `as_of` means
+    the local time of this call, not of publication, so that time spent
+    in the queue is counted against `error`. Only one thread at a time
+    may call this function for a given publisher. It never blocks, and is
+    async-signal-safe.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+
+    \exception EAGAIN The queue is full.
+*/
+int byztime_rt_enqueue(byztime_rt_publisher *pub, byztime_stamp const *offset,
+                       byztime_stamp const *error, byztime_stamp const *as_of);
+
+/** Gets a snapshot of a publisher's counters.
+
+    This may be called from any thread while the publisher is running.
+    Counters are read individually, so they may be mutually inconsistent
+    by an offset or two.
+*/
+void byztime_rt_get_stats(byztime_rt_publisher const *pub,
+                          byztime_rt_stats *stats);
+
+/** Stops a publisher and frees it.
+
+    Offsets queued before this call are published before the publisher
+    exits. It must be called from the thread that enqueues, or after that
+    thread has stopped enqueueing. If `pub` is `NULL`, this is a no-op.
+
+    \returns 0 on success.
+    \returns -1 on failure and sets `errno`.
+*/
+int byztime_rt_stop(byztime_rt_publisher *pub);
+
 /** @} */
 
 #endif
@@ -0,0 +1,537 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _GNU_SOURCE
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* Apache Arrow IPC writer.
+
+   Arrow's IPC formats frame each message as a FlatBuffers-encoded
+   header followed by a body of raw buffers. We only ever write one
+   kind of schema (some number of non-nullable timestamp[ns, UTC]
+   columns) and one kind of record batch, so rather than depend on the
+   FlatBuffers library we build the handful of tables we need by hand.
+
+   FlatBuffers are normally built back to front. We build ours front to
+   back instead: each table is preceded by its vtable, and the objects
+   it refers to follow it, with the offsets to them patched in once
+   their positions are known. FlatBuffers offsets are unsigned and
+   relative to where they are stored, so this only requires that every
+   object be written after whatever points at it. */
+
+#define ARROW_CONTINUATION 0xffffffffu
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_TIMESTAMP 10
+#define ARROW_TIME_UNIT_NANOSECOND 3
+
+static const char arrow_magic[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+
+/* Number of rows converted at a time by byztime_arrow_write_stamps(). */
+#define ARROW_CONVERT_CHUNK 4096
+
+typedef struct fb_s {
+  uint8_t *buf;
+  size_t len;
+  size_t cap;
+  bool failed;
+} fb;
+
+typedef struct fb_field_s {
+  uint16_t id;
+  uint8_t size;
+  uint64_t value;
+  /* Filled in by fb_table(): where the field was written. */
+  size_t pos;
+} fb_field;
+
+static void fb_reserve(fb *b, size_t n) {
+  size_t cap = b->cap ? b->cap : 256;
+  uint8_t *buf;
+
+  if (b->failed || b->len + n <= b->cap) return;
+  while (cap < b->len + n) cap *= 2;
+  buf = realloc(b->buf, cap);
+  if (buf == NULL) {
+    b->failed = true;
+    return;
+  }
+  b->buf = buf;
+  b->cap = cap;
+}
+
+static void put_le(uint8_t *p, uint64_t v, size_t size) {
+  for (size_t k = 0; k < size; k++) p[k] = (uint8_t)(v >> (8 * k));
+}
+
+static size_t fb_push(fb *b, uint64_t v, size_t size) {
+  size_t pos = b->len;
+  fb_reserve(b, size);
+  if (b->failed) return pos;
+  put_le(b->buf + pos, v, size);
+  b->len += size;
+  return pos;
+}
+
+/* Pads with zeros until len % align == phase. */
+static void fb_pad(fb *b, size_t align, size_t phase) {
+  while (!b->failed && b->len % align != phase) fb_push(b, 0, 1);
+}
+
+/* Stores at `pos` the offset from there to `target`. */
+static void fb_patch(fb *b, size_t pos, size_t target) {
+  if (b->failed) return;
+  put_le(b->buf + pos, (uint32_t)(target - pos), 4);
+}
+
+/* Writes a vtable and a table holding `fields`, which must be listed
+   in order of decreasing size so that each is naturally aligned.
+   Offset fields are written as zero, to be patched later. Returns the
+   table's position. */
+static size_t fb_table(fb *b, fb_field fields[], size_t n, uint16_t nslots) {
+  uint16_t vt_size = 4 + 2 * nslots, table_size = 4, offset;
+  size_t vt_pos, table_pos;
+  bool wide = n > 0 && fields[0].size == 8;
+
+  for (size_t k = 0; k < n; k++) table_size += fields[k].size;
+
+  /* The table's soffset is 4 bytes, so for 8-byte fields to be aligned
+     the table must start 4 bytes past an 8-byte boundary. */
+  if (wide) {
+    fb_pad(b, 8, (size_t)(12 - vt_size % 8) % 8);
+  } else {
+    fb_pad(b, 4, (size_t)(4 - vt_size % 4) % 4);
+  }
+
+  vt_pos = fb_push(b, vt_size, 2);
+  fb_push(b, table_size, 2);
+  for (uint16_t slot = 0; slot < nslots; slot++) {
+    offset = 0;
+    uint16_t at = 4;
+    for (size_t k = 0; k < n; k++) {
+      if (fields[k].id == slot) offset = at;
+      at += fields[k].size;
+    }
+    fb_push(b, offset, 2);
+  }
+
+  table_pos = fb_push(b, (uint32_t)(b->len - vt_pos), 4);
+  for (size_t k = 0; k < n; k++) {
+    fields[k].pos = fb_push(b, fields[k].value, fields[k].size);
+  }
+  return table_pos;
+}
+
+static size_t fb_string(fb *b, char const *s) {
+  size_t n = strlen(s), pos;
+
+  fb_pad(b, 4, 0);
+  pos = fb_push(b, (uint32_t)n, 4);
+  fb_reserve(b, n + 1);
+  if (b->failed) return pos;
+  memcpy(b->buf + b->len, s, n + 1);
+  b->len += n + 1;
+  return pos;
+}
+
+/* Starts a vector of `count` 8-byte-aligned structs or 4-byte offsets.
+   The caller pushes the elements. */
+static size_t fb_vector(fb *b, size_t count, bool wide) {
+  if (wide) {
+    fb_pad(b, 8, 4);
+  } else {
+    fb_pad(b, 4, 0);
+  }
+  return fb_push(b, (uint32_t)count, 4);
+}
+
+struct byztime_arrow_writer_s {
+  int fd;
+  int format;
+  size_t ncolumns;
+  char **names;
+  /* Bytes written since byztime_arrow_open(). */
+  uint64_t pos;
+  /* For the file footer: where each record batch is. */
+  struct arrow_block_s {
+    uint64_t offset;
+    int32_t metadata_length;
+    uint64_t body_length;
+  } * blocks;
+  size_t nblocks;
+  size_t blocks_cap;
+  int64_t *scratch;
+  bool failed;
+};
+
+/* Writes all of `iov`, which it may modify. */
+static int write_all(byztime_arrow_writer *w, struct iovec *iov, int iovcnt) {
+  while (iovcnt > 0) {
+    int batch = iovcnt < IOV_MAX ? iovcnt : IOV_MAX;
+    ssize_t written = writev(w->fd, iov, batch);
+
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      w->failed = true;
+      return -1;
+    }
+    w->pos += (uint64_t)written;
+
+    while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+      written -= (ssize_t)iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char *)iov->iov_base + written;
+      iov->iov_len -= (size_t)written;
+    }
+  }
+  return 0;
+}
+
+/* Builds a Schema table describing our columns and returns its
+   position. */
+static size_t build_schema(fb *b, byztime_arrow_writer const *w) {
+  fb_field schema[] = {{1, 4, 0, 0}};
+  size_t schema_pos, fields_pos;
+
+  schema_pos = fb_table(b, schema, 1, 2);
+  fields_pos = fb_vector(b, w->ncolumns, false);
+  fb_patch(b, schema[0].pos, fields_pos);
+  for (size_t k = 0; k < w->ncolumns; k++) fb_push(b, 0, 4);
+
+  for (size_t k = 0; k < w->ncolumns; k++) {
+    /* name, type, children, type_type */
+    fb_field field[] = {{0, 4, 0, 0},
+                        {3, 4, 0, 0},
+                        {5, 4, 0, 0},
+                        {2, 1, ARROW_TYPE_TIMESTAMP, 0}};
+    /* timezone, unit */
+    fb_field timestamp[] = {{1, 4, 0, 0},
+                            {0, 2, ARROW_TIME_UNIT_NANOSECOND, 0}};
+    size_t field_pos, pos;
+
+    field_pos = fb_table(b, field, 4, 7);
+    fb_patch(b, fields_pos + 4 + 4 * k, field_pos);
+
+    pos = fb_string(b, w->names[k]);
+    fb_patch(b, field[0].pos, pos);
+
+    pos = fb_table(b, timestamp, 2, 2);
+    fb_patch(b, field[1].pos, pos);
+    pos = fb_string(b, "UTC");
+    fb_patch(b, timestamp[0].pos, pos);
+
+    pos = fb_vector(b, 0, false);
+    fb_patch(b, field[2].pos, pos);
+  }
+
+  return schema_pos;
+}
+
+/* Starts a Message with the given header type and body length.
+   Returns the position of the header offset to be patched. */
+static size_t build_message(fb *b, uint8_t header_type, uint64_t body_len) {
+  /* bodyLength, header, version, header_type */
+  fb_field message[] = {{3, 8, body_len, 0},
+                        {2, 4, 0, 0},
+                        {0, 2, ARROW_METADATA_V5, 0},
+                        {1, 1, header_type, 0}};
+  size_t root = fb_push(b, 0, 4);
+  size_t pos = fb_table(b, message, 4, 5);
+
+  fb_patch(b, root, pos);
+  return message[1].pos;
+}
+
+/* Writes an encapsulated message: continuation marker, metadata length,
+   metadata padded to 8 bytes, then the body. */
+static int write_message(byztime_arrow_writer *w, fb *b, struct iovec *body,
+                         int nbody, uint64_t body_len) {
+  uint8_t prefix[8];
+  struct iovec *iov;
+  uint64_t start = w->pos;
+  int ret;
+
+  fb_pad(b, 8, 0);
+  if (b->failed) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  iov = malloc(sizeof(struct iovec) * (size_t)(nbody + 2));
+  if (iov == NULL) return -1;
+
+  put_le(prefix, ARROW_CONTINUATION, 4);
+  put_le(prefix + 4, (uint32_t)b->len, 4);
+  iov[0].iov_base = prefix;
+  iov[0].iov_len = sizeof prefix;
+  iov[1].iov_base = b->buf;
+  iov[1].iov_len = b->len;
+  if (nbody > 0) memcpy(iov + 2, body, sizeof(struct iovec) * (size_t)nbody);
+
+  ret = write_all(w, iov, nbody + 2);
+  free(iov);
+  if (ret < 0) return -1;
+
+  if (body != NULL && w->format == BYZTIME_ARROW_FILE) {
+    if (w->nblocks == w->blocks_cap) {
+      size_t cap = w->blocks_cap ? 2 * w->blocks_cap : 16;
+      void *blocks = realloc(w->blocks, cap * sizeof *w->blocks);
+      if (blocks == NULL) {
+        w->failed = true;
+        return -1;
+      }
+      w->blocks = blocks;
+      w->blocks_cap = cap;
+    }
+    w->blocks[w->nblocks].offset = start;
+    w->blocks[w->nblocks].metadata_length = (int32_t)(8 + b->len);
+    w->blocks[w->nblocks].body_length = body_len;
+    w->nblocks++;
+  }
+
+  return 0;
+}
+
+void byztime_arrow_abort(byztime_arrow_writer *w) {
+  if (w == NULL) return;
+  for (size_t k = 0; k < w->ncolumns; k++) free(w->names[k]);
+  free(w->names);
+  free(w->blocks);
+  free(w->scratch);
+  free(w);
+}
+
+byztime_arrow_writer *byztime_arrow_open(int fd, int format,
+                                         char const *const names[],
+                                         size_t ncolumns) {
+  byztime_arrow_writer *w;
+  fb b = {0};
+  size_t header;
+  int saved_errno;
+
+  if ((format != BYZTIME_ARROW_STREAM && format != BYZTIME_ARROW_FILE) ||
+      ncolumns == 0 || ncolumns > INT_MAX / 2) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  w = calloc(1, sizeof(byztime_arrow_writer));
+  if (w == NULL) return NULL;
+  w->fd = fd;
+  w->format = format;
+
+  w->names = calloc(ncolumns, sizeof(char *));
+  if (w->names == NULL) goto fail;
+  for (size_t k = 0; k < ncolumns; k++) {
+    w->names[k] = strdup(names[k]);
+    if (w->names[k] == NULL) goto fail;
+    w->ncolumns = k + 1;
+  }
+
+  w->scratch = malloc(sizeof(int64_t) * ARROW_CONVERT_CHUNK * ncolumns);
+  if (w->scratch == NULL) goto fail;
+
+  if (format == BYZTIME_ARROW_FILE) {
+    struct iovec iov = {(void *)arrow_magic, sizeof arrow_magic};
+    if (write_all(w, &iov, 1) < 0) goto fail;
+  }
+
+  header = build_message(&b, ARROW_HEADER_SCHEMA, 0);
+  fb_patch(&b, header, build_schema(&b, w));
+  if (write_message(w, &b, NULL, 0, 0) < 0) goto fail;
+  free(b.buf);
+
+  return w;
+
+fail:
+  saved_errno = errno;
+  free(b.buf);
+  byztime_arrow_abort(w);
+  errno = saved_errno;
+  return NULL;
+}
+
+int byztime_arrow_write_ns(byztime_arrow_writer *w,
+                           int64_t const *const columns[], size_t nrows) {
+  fb b = {0};
+  struct iovec *body;
+  uint64_t column_len, body_len;
+  size_t batch_pos, pos;
+  int ret;
+
+  if (w->failed) {
+    errno = EIO;
+    return -1;
+  }
+
+  if (nrows > INT64_MAX / sizeof(int64_t) / w->ncolumns) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  column_len = nrows * sizeof(int64_t);
+  body_len = column_len * w->ncolumns;
+
+  /* length, nodes, buffers */
+  fb_field batch[] = {{0, 8, nrows, 0}, {1, 4, 0, 0}, {2, 4, 0, 0}};
+  size_t header = build_message(&b, ARROW_HEADER_RECORD_BATCH, body_len);
+  batch_pos = fb_table(&b, batch, 3, 3);
+  fb_patch(&b, header, batch_pos);
+
+  /* One FieldNode {length, null_count} per column */
+  pos = fb_vector(&b, w->ncolumns, true);
+  fb_patch(&b, batch[1].pos, pos);
+  for (size_t k = 0; k < w->ncolumns; k++) {
+    fb_push(&b, nrows, 8);
+    fb_push(&b, 0, 8);
+  }
+
+  /* Two Buffers {offset, length} per column: an empty validity bitmap,
+     since there are no nulls, and the values. */
+  pos = fb_vector(&b, 2 * w->ncolumns, true);
+  fb_patch(&b, batch[2].pos, pos);
+  for (size_t k = 0; k < w->ncolumns; k++) {
+    fb_push(&b, k * column_len, 8);
+    fb_push(&b, 0, 8);
+    fb_push(&b, k * column_len, 8);
+    fb_push(&b, column_len, 8);
+  }
+
+  /* The values go straight from the caller's buffers to the fd. */
+  body = malloc(sizeof(struct iovec) * w->ncolumns);
+  if (body == NULL) {
+    free(b.buf);
+    return -1;
+  }
+  for (size_t k = 0; k < w->ncolumns; k++) {
+    body[k].iov_base = (void *)columns[k];
+    body[k].iov_len = column_len;
+  }
+
+  ret = write_message(w, &b, body, (int)w->ncolumns, body_len);
+  free(body);
+  free(b.buf);
+  return ret;
+}
+
+int byztime_arrow_write_stamps(byztime_arrow_writer *w,
+                               byztime_stamp const *const columns[],
+                               size_t nrows, byztime_stamp const *real_offset) {
+  int64_t const **chunk;
+  int64_t shift = 0;
+  int ret = 0;
+
+  if (real_offset != NULL && stamp_to_ns(&shift, real_offset) < 0) return -1;
+
+  chunk = malloc(sizeof(int64_t *) * w->ncolumns);
+  if (chunk == NULL) return -1;
+  for (size_t k = 0; k < w->ncolumns; k++) {
+    chunk[k] = w->scratch + k * ARROW_CONVERT_CHUNK;
+  }
+
+  /* Convert in chunks small enough to stay in cache, writing each as a
+     record batch of its own. */
+  for (size_t start = 0; start < nrows && ret == 0;
+       start += ARROW_CONVERT_CHUNK) {
+    size_t n = nrows - start < ARROW_CONVERT_CHUNK ? nrows - start
+                                                   : ARROW_CONVERT_CHUNK;
+    for (size_t k = 0; k < w->ncolumns && ret == 0; k++) {
+      int64_t *out = w->scratch + k * ARROW_CONVERT_CHUNK;
+      for (size_t r = 0; r < n; r++) {
+        if (stamp_to_ns(&out[r], &columns[k][start + r]) < 0 ||
+            __builtin_sub_overflow(out[r], shift, &out[r])) {
+          errno = EOVERFLOW;
+          ret = -1;
+          break;
+        }
+      }
+    }
+    if (ret == 0) ret = byztime_arrow_write_ns(w, chunk, n);
+  }
+
+  free(chunk);
+  return ret;
+}
+
+int byztime_arrow_close(byztime_arrow_writer *w) {
+  fb b = {0};
+  uint8_t eos[8];
+  struct iovec iov;
+  int ret = -1, saved_errno;
+
+  if (w->failed) {
+    errno = EIO;
+    goto out;
+  }
+
+  put_le(eos, ARROW_CONTINUATION, 4);
+  put_le(eos + 4, 0, 4);
+  iov.iov_base = eos;
+  iov.iov_len = sizeof eos;
+  if (write_all(w, &iov, 1) < 0) goto out;
+
+  if (w->format == BYZTIME_ARROW_FILE) {
+    /* schema, dictionaries, recordBatches, version */
+    fb_field footer[] = {{1, 4, 0, 0},
+                         {2, 4, 0, 0},
+                         {3, 4, 0, 0},
+                         {0, 2, ARROW_METADATA_V5, 0}};
+    struct iovec tail[2];
+    uint8_t trailer[10];
+    size_t root, pos;
+
+    root = fb_push(&b, 0, 4);
+    pos = fb_table(&b, footer, 4, 5);
+    fb_patch(&b, root, pos);
+
+    pos = fb_vector(&b, 0, true);
+    fb_patch(&b, footer[1].pos, pos);
+
+    /* Block {offset: long, metaDataLength: int, pad, bodyLength: long} */
+    pos = fb_vector(&b, w->nblocks, true);
+    fb_patch(&b, footer[2].pos, pos);
+    for (size_t k = 0; k < w->nblocks; k++) {
+      fb_push(&b, w->blocks[k].offset, 8);
+      fb_push(&b, (uint32_t)w->blocks[k].metadata_length, 4);
+      fb_push(&b, 0, 4);
+      fb_push(&b, w->blocks[k].body_length, 8);
+    }
+
+    pos = build_schema(&b, w);
+    fb_patch(&b, footer[0].pos, pos);
+
+    if (b.failed) {
+      errno = ENOMEM;
+      goto out;
+    }
+
+    put_le(trailer, (uint32_t)b.len, 4);
+    memcpy(trailer + 4, arrow_magic, 6);
+    tail[0].iov_base = b.buf;
+    tail[0].iov_len = b.len;
+    tail[1].iov_base = trailer;
+    tail[1].iov_len = sizeof trailer;
+    if (write_all(w, tail, 2) < 0) goto out;
+  }
+
+  ret = 0;
+
+out:
+  saved_errno = errno;
+  free(b.buf);
+  byztime_arrow_abort(w);
+  errno = saved_errno;
+  return ret;
+}
@@ -0,0 +1,138 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_internal.h"
+
+#include <errno.h>
+
+/* Civil dates in the proleptic Gregorian calendar.
+
+   These are Howard Hinnant's days_from_civil and civil_from_days. Both
+   shift the year to begin on March 1, so that the leap day falls at its
+   end, and work in 400-year eras of exactly 146097 days. Everything is
+   integer arithmetic on int64_t with no tables, locks, or time zones,
+   and the only divisions are by constants. */
+
+#define SECONDS_PER_DAY 86400
+
+/* Days from 0000-03-01 to 1970-01-01. */
+#define EPOCH_SHIFT 719468
+
+/* A year comfortably beyond the range of byztime_stamp, about 2.9e11
+   years either way. Checking against it first keeps the arithmetic in
+   days_from_civil from overflowing. */
+#define MAX_CIVIL_YEAR 400000000000LL
+
+static inline int64_t floor_div(int64_t a, int64_t b) {
+  int64_t q = a / b;
+  return q - ((a % b) < 0);
+}
+
+static inline void civil_from_days(int64_t z, int64_t *year, int *month,
+                                   int *day) {
+  int64_t era, doe, yoe, doy, mp, y;
+
+  z += EPOCH_SHIFT;
+  era = floor_div(z, 146097);
+  doe = z - era * 146097;
+  yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  y = yoe + era * 400;
+  doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  mp = (5 * doy + 2) / 153;
+  *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+  *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+  *year = y + (*month <= 2);
+}
+
+static inline int64_t days_from_civil(int64_t year, int month, int day) {
+  int64_t y = year - (month <= 2);
+  int64_t era = floor_div(y, 400);
+  int64_t yoe = y - era * 400;
+  int64_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - EPOCH_SHIFT;
+}
+
+static inline int days_in_month(int64_t year, int month) {
+  static const unsigned char lengths[12] = {31, 28, 31, 30, 31, 30,
+                                            31, 31, 30, 31, 30, 31};
+  bool leap = (year % 4 == 0) && (year % 100 != 0 || year % 400 == 0);
+  return lengths[month - 1] + (month == 2 && leap);
+}
+
+static inline int stamp_to_civil(byztime_civil *civil,
+                                 byztime_stamp const *stamp) {
+  byztime_stamp s = *stamp;
+  int64_t days, sod;
+
+  if (byztime_stamp_normalize(&s) < 0) return -1;
+
+  days = floor_div(s.seconds, SECONDS_PER_DAY);
+  sod = s.seconds - days * SECONDS_PER_DAY;
+
+  civil_from_days(days, &civil->year, &civil->month, &civil->day);
+  civil->hour = (int)(sod / 3600);
+  civil->minute = (int)(sod / 60 % 60);
+  civil->second = (int)(sod % 60);
+  civil->nanosecond = (int)s.nanoseconds;
+  /* 1970-01-01 was a Thursday. */
+  civil->weekday = (int)(days + 4 - floor_div(days + 4, 7) * 7);
+  return 0;
+}
+
+int byztime_stamp_to_civil(byztime_civil *civil, byztime_stamp const *stamp) {
+  return stamp_to_civil(civil, stamp);
+}
+
+int byztime_stamp_from_civil(byztime_stamp *stamp, byztime_civil const *civil) {
+  __int128 seconds;
+
+  if (civil->month < 1 || civil->month > 12 || civil->day < 1 ||
+      civil->hour < 0 || civil->hour > 23 || civil->minute < 0 ||
+      civil->minute > 59 || civil->second < 0 || civil->second > 59 ||
+      civil->nanosecond < 0 || civil->nanosecond >= billion) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (civil->year > MAX_CIVIL_YEAR || civil->year < -MAX_CIVIL_YEAR) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  if (civil->day > days_in_month(civil->year, civil->month)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* The earliest representable day starts before INT64_MIN seconds, so
+     the sum is formed in 128 bits and range-checked only at the end. */
+  seconds = (__int128)days_from_civil(civil->year, civil->month, civil->day) *
+                SECONDS_PER_DAY +
+            civil->hour * 3600 + civil->minute * 60 + civil->second;
+  if (seconds < INT64_MIN || seconds > INT64_MAX) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  stamp->seconds = (int64_t)seconds;
+  stamp->nanoseconds = civil->nanosecond;
+  return 0;
+}
+
+int byztime_stamp_to_civil_batch(byztime_civil civil[],
+                                 byztime_stamp const stamps[], size_t n) {
+  for (size_t k = 0; k < n; k++) {
+    if (stamp_to_civil(&civil[k], &stamps[k]) < 0) return -1;
+  }
+  return 0;
+}
+
+int byztime_stamp_from_civil_batch(byztime_stamp stamps[],
+                                   byztime_civil const civil[], size_t n) {
+  for (size_t k = 0; k < n; k++) {
+    if (byztime_stamp_from_civil(&stamps[k], &civil[k]) < 0) return -1;
+  }
+  return 0;
+}
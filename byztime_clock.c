@@ -0,0 +1,327 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/timex.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Cross-clock calibration.
+
+   Kernel facilities such as SO_TIMESTAMPING, perf and input events hand
+   out timestamps on clocks other than CLOCK_MONOTONIC_RAW. To relate
+   them to local time we keep, for each such clock, a short history of
+   samples, each of which pairs a reading of that clock with the
+   midpoint of the CLOCK_MONOTONIC_RAW readings taken immediately before
+   and after it. Of several attempts we keep the one whose two raw
+   readings are closest together, which filters out attempts that were
+   preempted or interrupted.
+
+   Between and beyond samples we rely on every clock we support
+   advancing at a rate within byztime_mono_adj_bound_ppb() of
+   CLOCK_MONOTONIC_RAW, which is as far as the kernel's NTP discipline
+   and tick length can push it. Each history remembers the largest such
+   bound in effect at any of its samples. This holds except across a
+   step: settimeofday() for CLOCK_REALTIME and
+   CLOCK_TAI, or a suspend for CLOCK_BOOTTIME. A sample inconsistent
+   with its predecessor reveals a step, and the history before it is
+   discarded. Timestamps taken before a step will be converted as
+   though the step had not occurred.
+
+   The history is shared by all threads and protected by a mutex, but
+   conversions take a copy of it and do their arithmetic unlocked. */
+
+#define CAL_MAX_CLOCK 16
+#define CAL_ATTEMPTS 5
+
+/* Samples are taken at most this often, and a conversion triggers a
+   new one if the newest is older than this. */
+static const int64_t cal_interval = 100000000;
+
+typedef struct cal_history_s {
+  int nsamples;
+  int head;
+  int64_t adj_ppb;
+  cal_sample samples[CAL_SAMPLES];
+} cal_history;
+
+static pthread_mutex_t cal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static cal_history cal_histories[CAL_MAX_CLOCK];
+
+static bool clock_supported(clockid_t clock) {
+  return clock == CLOCK_REALTIME || clock == CLOCK_MONOTONIC ||
+         clock == CLOCK_BOOTTIME || clock == CLOCK_TAI;
+}
+
+int64_t byztime_mono_adj_bound_ppb(void) {
+  struct timex tx;
+  long hz = sysconf(_SC_CLK_TCK);
+  int64_t tick_adj;
+
+  memset(&tx, 0, sizeof tx);
+  if (hz <= 0 || adjtimex(&tx) < 0) return max_mono_adj_ppb + max_tick_adj_ppb;
+
+  /* `tick` is in microseconds per USER_HZ tick, so this is the change
+     in microseconds per second. */
+  tick_adj = (int64_t)tx.tick * hz - 1000000;
+  if (tick_adj < 0) tick_adj = -tick_adj;
+  if (tick_adj > max_tick_adj_ppb / 1000) tick_adj = max_tick_adj_ppb / 1000;
+  return max_mono_adj_ppb + tick_adj * 1000;
+}
+
+static int read_ns(clockid_t clock, int64_t *ns) {
+  struct timespec ts;
+  if (clock_gettime(clock, &ts) < 0) return -1;
+  *ns = (int64_t)ts.tv_sec * billion + ts.tv_nsec;
+  return 0;
+}
+
+static int take_sample(clockid_t clock, cal_sample *sample) {
+  int64_t best_width = INT64_MAX;
+
+  for (int attempt = 0; attempt < CAL_ATTEMPTS; attempt++) {
+    int64_t raw1, other, raw2;
+    if (read_ns(CLOCK_MONOTONIC_RAW, &raw1) < 0 || read_ns(clock, &other) < 0 ||
+        read_ns(CLOCK_MONOTONIC_RAW, &raw2) < 0) {
+      return -1;
+    }
+    if (raw2 - raw1 < best_width) {
+      best_width = raw2 - raw1;
+      sample->clock = other;
+      sample->raw = raw1 + best_width / 2;
+    }
+  }
+
+  sample->err = best_width / 2 + 1;
+  return 0;
+}
+
+/* Scales a clock interval by (billion + ppb) / billion, rounding down or
+   up. */
+static __int128 scale_floor(__int128 interval, int64_t ppb) {
+  __int128 prod = interval * (billion + ppb);
+  __int128 q = prod / billion;
+  return (prod % billion < 0) ? q - 1 : q;
+}
+
+static __int128 scale_ceil(__int128 interval, int64_t ppb) {
+  __int128 prod = interval * (billion + ppb);
+  __int128 q = prod / billion;
+  return (prod % billion > 0) ? q + 1 : q;
+}
+
+static void add_sample(cal_history *hist, cal_sample const *sample,
+                       int64_t adj_ppb) {
+  if (hist->nsamples > 0) {
+    cal_sample const *prev =
+        &hist->samples[(hist->head + CAL_SAMPLES - 1) % CAL_SAMPLES];
+    __int128 elapsed = (__int128)sample->clock - prev->clock;
+    __int128 raw_elapsed = (__int128)sample->raw - prev->raw;
+    __int128 slack = (__int128)sample->err + prev->err;
+    int64_t bound = hist->adj_ppb > adj_ppb ? hist->adj_ppb : adj_ppb;
+
+    if (elapsed < 0 || raw_elapsed < scale_floor(elapsed, -bound) - slack ||
+        raw_elapsed > scale_ceil(elapsed, bound) + slack) {
+      hist->nsamples = 0;
+    } else {
+      adj_ppb = bound;
+    }
+  }
+
+  hist->adj_ppb = adj_ppb;
+
+  hist->samples[hist->head] = *sample;
+  hist->head = (hist->head + 1) % CAL_SAMPLES;
+  if (hist->nsamples < CAL_SAMPLES) hist->nsamples++;
+}
+
+static int calibrate_locked(clockid_t clock, bool force) {
+  cal_history *hist = &cal_histories[clock];
+  cal_sample sample;
+
+  if (!force && hist->nsamples > 0) {
+    int64_t now;
+    cal_sample const *newest =
+        &hist->samples[(hist->head + CAL_SAMPLES - 1) % CAL_SAMPLES];
+    if (read_ns(CLOCK_MONOTONIC_RAW, &now) < 0) return -1;
+    if (now - newest->raw < cal_interval) return 0;
+  }
+
+  if (take_sample(clock, &sample) < 0) return -1;
+  add_sample(hist, &sample, byztime_mono_adj_bound_ppb());
+  return 0;
+}
+
+int byztime_clock_calibrate(clockid_t clock) {
+  int ret;
+
+  if (clock == CLOCK_MONOTONIC_RAW) return 0;
+  if (!clock_supported(clock)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ret = pthread_mutex_lock(&cal_mutex);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+  ret = calibrate_locked(clock, true);
+  pthread_mutex_unlock(&cal_mutex);
+  return ret;
+}
+
+int byztime_cal_snapshot(clockid_t clock, cal_snapshot *snap) {
+  cal_history *hist;
+  int ret;
+
+  snap->identity = clock == CLOCK_MONOTONIC_RAW;
+  snap->nsamples = 0;
+  snap->rate_ppb = 0;
+  snap->adj_ppb = 0;
+  if (snap->identity) return 0;
+
+  if (!clock_supported(clock)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ret = pthread_mutex_lock(&cal_mutex);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+
+  if (calibrate_locked(clock, false) < 0) {
+    pthread_mutex_unlock(&cal_mutex);
+    return -1;
+  }
+
+  /* Copy out in chronological order */
+  hist = &cal_histories[clock];
+  snap->nsamples = hist->nsamples;
+  snap->adj_ppb = hist->adj_ppb;
+  for (int k = 0; k < hist->nsamples; k++) {
+    snap->samples[k] =
+        hist->samples[(hist->head + CAL_SAMPLES - hist->nsamples + k) %
+                      CAL_SAMPLES];
+  }
+  pthread_mutex_unlock(&cal_mutex);
+
+  /* The fit's slope comes from the oldest and newest samples, over
+     which the bracketing error is spread most thinly. */
+  if (snap->nsamples >= 2) {
+    cal_sample const *first = &snap->samples[0];
+    cal_sample const *last = &snap->samples[snap->nsamples - 1];
+    __int128 elapsed = (__int128)last->clock - first->clock;
+    if (elapsed > 0) {
+      snap->rate_ppb = (int64_t)(((__int128)last->raw - first->raw - elapsed) *
+                                 billion / elapsed);
+    }
+  }
+
+  return 0;
+}
+
+void byztime_cal_convert(cal_snapshot const *snap, int64_t x, int64_t *lo,
+                         int64_t *est, int64_t *hi) {
+  cal_sample const *a = NULL, *b = NULL;
+  __int128 my_lo = INT64_MIN, my_hi = INT64_MAX, my_est;
+  int left = 0, right = snap->nsamples;
+
+  if (snap->identity) {
+    *lo = *est = *hi = x;
+    return;
+  }
+
+  /* Find the samples on either side of x */
+  while (left < right) {
+    int mid = left + (right - left) / 2;
+    if (snap->samples[mid].clock <= x) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  if (left > 0) a = &snap->samples[left - 1];
+  if (left < snap->nsamples) b = &snap->samples[left];
+
+  if (a != NULL) {
+    __int128 d = (__int128)x - a->clock;
+    my_lo = a->raw - a->err + scale_floor(d, -snap->adj_ppb);
+    my_hi = a->raw + a->err + scale_ceil(d, snap->adj_ppb);
+  }
+
+  if (b != NULL) {
+    __int128 d = (__int128)b->clock - x;
+    __int128 b_lo = b->raw - b->err - scale_ceil(d, snap->adj_ppb);
+    __int128 b_hi = b->raw + b->err - scale_floor(d, -snap->adj_ppb);
+    if (b_lo > my_lo) my_lo = b_lo;
+    if (b_hi < my_hi) my_hi = b_hi;
+  }
+
+  if (a != NULL && b != NULL) {
+    my_est = a->raw + ((__int128)x - a->clock) * ((__int128)b->raw - a->raw) /
+                          ((__int128)b->clock - a->clock);
+  } else if (a != NULL) {
+    my_est = a->raw + ((__int128)x - a->clock) * (billion + snap->rate_ppb) /
+                          billion;
+  } else if (b != NULL) {
+    my_est = b->raw - ((__int128)b->clock - x) * (billion + snap->rate_ppb) /
+                          billion;
+  } else {
+    my_est = x;
+  }
+
+  if (my_est < my_lo) my_est = my_lo;
+  if (my_est > my_hi) my_est = my_hi;
+
+  *lo = my_lo < INT64_MIN ? INT64_MIN : (int64_t)my_lo;
+  *hi = my_hi > INT64_MAX ? INT64_MAX : (int64_t)my_hi;
+  *est = (int64_t)my_est;
+}
+
+int byztime_convert_from_clock_batch(byztime_ctx *ctx, clockid_t clock,
+                                     byztime_stamp const ts[], size_t n,
+                                     byztime_interval out[]) {
+  cal_snapshot snap;
+  timedata_entry entry;
+  timedata_aux aux;
+
+  if (byztime_cal_snapshot(clock, &snap) < 0 ||
+      byztime_load_entry(ctx, &entry, &aux) < 0) {
+    return -1;
+  }
+
+  for (size_t k = 0; k < n; k++) {
+    int64_t x, lo, est, hi;
+    if (stamp_to_ns(&x, &ts[k]) < 0) return -1;
+    byztime_cal_convert(&snap, x, &lo, &est, &hi);
+    if (byztime_entry_global_time(ctx, &entry, &aux, lo, est, hi, &out[k]) <
+        0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int byztime_convert_from_clock(byztime_ctx *ctx, clockid_t clock,
+                               byztime_stamp const *ts, byztime_stamp *min,
+                               byztime_stamp *est, byztime_stamp *max) {
+  byztime_interval out;
+
+  if (byztime_convert_from_clock_batch(ctx, clock, ts, 1, &out) < 0) return -1;
+
+  if (min != NULL) *min = out.min;
+  if (est != NULL) *est = out.est;
+  if (max != NULL) *max = out.max;
+  return 0;
+}
@@ -0,0 +1,187 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <stdint.h>
+
+/* Column-wise stamp kernels.
+
+   Every loop below is written so that the compiler can vectorize it:
+   no calls, no data-dependent branches, and overflow accumulated with
+   bitwise arithmetic rather than __builtin_*_overflow, which GCC won't
+   vectorize. Comparisons rely on the inputs being normalized, so that
+   (seconds, nanoseconds) order lexicographically. Outputs may be the
+   same columns as inputs: each element is read in full before it is
+   written. */
+
+void byztime_columns_from_stamps(byztime_stamp_columns const *out,
+                                 byztime_stamp const stamps[], size_t n) {
+  int64_t *restrict seconds = out->seconds;
+  int64_t *restrict nanoseconds = out->nanoseconds;
+
+  for (size_t k = 0; k < n; k++) {
+    seconds[k] = stamps[k].seconds;
+    nanoseconds[k] = stamps[k].nanoseconds;
+  }
+}
+
+void byztime_columns_to_stamps(byztime_stamp stamps[],
+                               byztime_stamp_columns const *in, size_t n) {
+  int64_t const *restrict seconds = in->seconds;
+  int64_t const *restrict nanoseconds = in->nanoseconds;
+
+  for (size_t k = 0; k < n; k++) {
+    stamps[k].seconds = seconds[k];
+    stamps[k].nanoseconds = nanoseconds[k];
+  }
+}
+
+/* Signed overflow of x + y = r, or x - y = r, as the sign bit of the
+   result.
+
+   Adding seconds and then a carry can overflow twice, in opposite
+   directions: the seconds wrap below INT64_MIN and the carry brings
+   them back. The two flags are combined with XOR rather than OR so that
+   such a pair cancels out, and only a result that is really out of
+   range is reported. */
+static inline uint64_t add_overflowed(int64_t x, int64_t y, int64_t r) {
+  return ((uint64_t)x ^ (uint64_t)r) & ((uint64_t)y ^ (uint64_t)r);
+}
+
+static inline uint64_t sub_overflowed(int64_t x, int64_t y, int64_t r) {
+  return ((uint64_t)x ^ (uint64_t)y) & ((uint64_t)x ^ (uint64_t)r);
+}
+
+int byztime_columns_add(byztime_stamp_columns const *sum,
+                        byztime_stamp_columns const *a,
+                        byztime_stamp_columns const *b, size_t n) {
+  int64_t const *as = a->seconds, *ans = a->nanoseconds;
+  int64_t const *bs = b->seconds, *bns = b->nanoseconds;
+  int64_t *ss = sum->seconds, *sns = sum->nanoseconds;
+  uint64_t overflow = 0;
+
+  for (size_t k = 0; k < n; k++) {
+    int64_t xs = as[k], ys = bs[k];
+    int64_t s = (int64_t)((uint64_t)xs + (uint64_t)ys);
+    int64_t ns = ans[k] + bns[k];
+    int64_t carry = ns >= billion;
+    int64_t t = (int64_t)((uint64_t)s + (uint64_t)carry);
+    overflow |= add_overflowed(xs, ys, s) ^ add_overflowed(s, carry, t);
+    ss[k] = t;
+    sns[k] = ns - carry * billion;
+  }
+
+  if (overflow >> 63) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  return 0;
+}
+
+int byztime_columns_sub(byztime_stamp_columns const *diff,
+                        byztime_stamp_columns const *a,
+                        byztime_stamp_columns const *b, size_t n) {
+  int64_t const *as = a->seconds, *ans = a->nanoseconds;
+  int64_t const *bs = b->seconds, *bns = b->nanoseconds;
+  int64_t *ds = diff->seconds, *dns = diff->nanoseconds;
+  uint64_t overflow = 0;
+
+  for (size_t k = 0; k < n; k++) {
+    int64_t xs = as[k], ys = bs[k];
+    int64_t s = (int64_t)((uint64_t)xs - (uint64_t)ys);
+    int64_t ns = ans[k] - bns[k];
+    int64_t borrow = ns < 0;
+    int64_t t = (int64_t)((uint64_t)s - (uint64_t)borrow);
+    overflow |= sub_overflowed(xs, ys, s) ^ sub_overflowed(s, borrow, t);
+    ds[k] = t;
+    dns[k] = ns + borrow * billion;
+  }
+
+  if (overflow >> 63) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  return 0;
+}
+
+void byztime_columns_cmp(int8_t out[], byztime_stamp_columns const *a,
+                         byztime_stamp_columns const *b, size_t n) {
+  int64_t const *restrict as = a->seconds, *restrict ans = a->nanoseconds;
+  int64_t const *restrict bs = b->seconds, *restrict bns = b->nanoseconds;
+  int8_t *restrict o = out;
+
+  for (size_t k = 0; k < n; k++) {
+    int gt = (as[k] > bs[k]) | ((as[k] == bs[k]) & (ans[k] > bns[k]));
+    int lt = (as[k] < bs[k]) | ((as[k] == bs[k]) & (ans[k] < bns[k]));
+    o[k] = (int8_t)(gt - lt);
+  }
+}
+
+void byztime_columns_min(byztime_stamp_columns const *out,
+                         byztime_stamp_columns const *a,
+                         byztime_stamp_columns const *b, size_t n) {
+  int64_t const *as = a->seconds, *ans = a->nanoseconds;
+  int64_t const *bs = b->seconds, *bns = b->nanoseconds;
+  int64_t *os = out->seconds, *ons = out->nanoseconds;
+
+  for (size_t k = 0; k < n; k++) {
+    int64_t xs = as[k], xns = ans[k], ys = bs[k], yns = bns[k];
+    int lt = (ys < xs) | ((ys == xs) & (yns < xns));
+    os[k] = lt ? ys : xs;
+    ons[k] = lt ? yns : xns;
+  }
+}
+
+void byztime_columns_max(byztime_stamp_columns const *out,
+                         byztime_stamp_columns const *a,
+                         byztime_stamp_columns const *b, size_t n) {
+  int64_t const *as = a->seconds, *ans = a->nanoseconds;
+  int64_t const *bs = b->seconds, *bns = b->nanoseconds;
+  int64_t *os = out->seconds, *ons = out->nanoseconds;
+
+  for (size_t k = 0; k < n; k++) {
+    int64_t xs = as[k], xns = ans[k], ys = bs[k], yns = bns[k];
+    int gt = (ys > xs) | ((ys == xs) & (yns > xns));
+    os[k] = gt ? ys : xs;
+    ons[k] = gt ? yns : xns;
+  }
+}
+
+void byztime_columns_in_range(uint8_t mask[], byztime_stamp_columns const *in,
+                              byztime_stamp const *lo, byztime_stamp const *hi,
+                              size_t n) {
+  int64_t const *restrict s = in->seconds, *restrict ns = in->nanoseconds;
+  uint8_t *restrict m = mask;
+  int64_t los = lo->seconds, lons = lo->nanoseconds;
+  int64_t his = hi->seconds, hins = hi->nanoseconds;
+
+  for (size_t k = 0; k < n; k++) {
+    int ge_lo = (s[k] > los) | ((s[k] == los) & (ns[k] >= lons));
+    int le_hi = (s[k] < his) | ((s[k] == his) & (ns[k] <= hins));
+    m[k] = (uint8_t)(ge_lo & le_hi);
+  }
+}
+
+size_t byztime_columns_filter(size_t indices[], byztime_stamp_columns const *in,
+                              byztime_stamp const *lo, byztime_stamp const *hi,
+                              size_t n) {
+  int64_t const *restrict s = in->seconds, *restrict ns = in->nanoseconds;
+  int64_t los = lo->seconds, lons = lo->nanoseconds;
+  int64_t his = hi->seconds, hins = hi->nanoseconds;
+  size_t count = 0;
+
+  /* Branch-free compaction: always store, advance only on a match.
+     `indices` has room for n entries, so the store is always in
+     bounds. */
+  for (size_t k = 0; k < n; k++) {
+    int ge_lo = (s[k] > los) | ((s[k] == los) & (ns[k] >= lons));
+    int le_hi = (s[k] < his) | ((s[k] == his) & (ns[k] <= hins));
+    indices[count] = k;
+    count += (size_t)(ge_lo & le_hi);
+  }
+
+  return count;
+}
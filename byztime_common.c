@@ -17,9 +17,10 @@
 
 int byztime_close(byztime_ctx *ctx) {
   int ret, saved_errno;
-  if (ctx == NULL) return 0;
+  if (ctx == NULL || ctx->is_default) return 0;
 
-  ret = munmap(ctx->timedata, sizeof(timedata));
+  byztime_provider_stop_tick(ctx);
+  ret = munmap(ctx->timedata, ctx->map_len);
   assert(ret == 0);
   ret = fsync(ctx->fd);
   saved_errno = errno;
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 
 #include "byztime_internal.h"
 
@@ -18,9 +19,16 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 static pthread_key_t sigbus_key;
+
+/* Jump context registered by byztime_get_global_time_signal_safe(),
+   which cannot use pthread_setspecific(). Because such a read may
+   interrupt an ordinary read on the same thread, the SIGBUS handler
+   checks this first: if it is set, it belongs to the innermost read. */
+static _Thread_local sigjmp_buf *volatile signal_safe_jmpbuf = NULL;
 static pthread_once_t sigbus_key_once = PTHREAD_ONCE_INIT;
 static int sigbus_key_create_result = 0;
 
@@ -52,6 +60,10 @@ void byztime_handle_sigbus(int signo, siginfo_t *info, void *context) {
      function wouldn't be safe in an asynchronous signal context. */
   if (info->si_code != BUS_ADRERR) return;
 
+  /* A read by byztime_get_global_time_signal_safe() is in progress, and
+     it is the innermost one. */
+  if (signal_safe_jmpbuf != NULL) siglongjmp(*signal_safe_jmpbuf, 1);
+
   /* If there was an error setting up thread-local storage, there's nothing
      we can do about here so just return. */
   if (byztime_init_sigbus_key() < 0) return;
@@ -81,6 +93,37 @@ int byztime_install_sigbus_handler(struct sigaction *oact) {
   return sigaction(SIGBUS, &sa, oact);
 }
 
+/* Returns whichever local clock source is cheaper to read on the running
+   kernel. CLOCK_MONOTONIC_RAW is only served from the vDSO on newer
+   kernels, whereas CLOCK_MONOTONIC has been for a long time; when both
+   are, there is nothing to gain from the correction that
+   CLOCK_MONOTONIC requires, so it has to win by a clear margin. */
+static int probe_local_clock(void) {
+  static const clockid_t clocks[2] = {CLOCK_MONOTONIC_RAW, CLOCK_MONOTONIC};
+  int64_t best[2] = {INT64_MAX, INT64_MAX};
+  struct timespec start, end, ts;
+
+  for (int round = 0; round < 4; round++) {
+    for (int c = 0; c < 2; c++) {
+      if (clock_gettime(CLOCK_MONOTONIC_RAW, &start) < 0) {
+        return BYZTIME_LOCAL_CLOCK_RAW;
+      }
+      for (int k = 0; k < 16; k++) {
+        if (clock_gettime(clocks[c], &ts) < 0) return BYZTIME_LOCAL_CLOCK_RAW;
+      }
+      if (clock_gettime(CLOCK_MONOTONIC_RAW, &end) < 0) {
+        return BYZTIME_LOCAL_CLOCK_RAW;
+      }
+      int64_t elapsed = (int64_t)(end.tv_sec - start.tv_sec) * billion +
+                        (end.tv_nsec - start.tv_nsec);
+      if (elapsed < best[c]) best[c] = elapsed;
+    }
+  }
+
+  return best[1] < best[0] / 2 ? BYZTIME_LOCAL_CLOCK_MONOTONIC
+                               : BYZTIME_LOCAL_CLOCK_RAW;
+}
+
 byztime_ctx *byztime_open_ro(char const *pathname) {
   byztime_ctx *ctx;
   unsigned char expected_era[BYZTIME_ERA_LEN], stored_era[BYZTIME_ERA_LEN];
@@ -111,8 +154,15 @@ byztime_ctx *byztime_open_ro(char const *pathname) {
     goto fail_free_ctx;
   }
 
-  ctx->timedata =
-      mmap(NULL, sizeof(timedata), PROT_READ, MAP_SHARED, ctx->fd, 0);
+  /* Map the extension region too if the file is long enough to hold
+     one. Whether it actually contains one is checked below. */
+  if (statbuf.st_size >= (off_t)(sizeof(timedata) + sizeof(timedata_ext))) {
+    ctx->map_len = sizeof(timedata) + sizeof(timedata_ext);
+  } else {
+    ctx->map_len = sizeof(timedata);
+  }
+
+  ctx->timedata = mmap(NULL, ctx->map_len, PROT_READ, MAP_SHARED, ctx->fd, 0);
   if (ctx->timedata == MAP_FAILED) goto fail_close;
 
   /* Set up a jump context for the SIGBUS handler to longjmp into. This function
@@ -150,9 +200,29 @@ byztime_ctx *byztime_open_ro(char const *pathname) {
     goto fail_unmap;
   }
 
+  ctx->ext = NULL;
+  if (ctx->map_len > sizeof(timedata)) {
+    timedata_ext *ext = (timedata_ext *)(ctx->timedata + 1);
+    load_magic(stored_magic, &ext->magic);
+    if (!memcmp(stored_magic, expected_ext_magic, sizeof expected_ext_magic)) {
+      ctx->ext = ext;
+    }
+  }
+
   ctx->lock_fd = -1;
+  ctx->local_clock = ctx->ext != NULL ? probe_local_clock()
+                                      : BYZTIME_LOCAL_CLOCK_RAW;
   ctx->drift_ppb = default_drift_ppb;
+  ctx->drift_err_mult = drift_ppb_to_err_mult(default_drift_ppb);
   ctx->slew_mode = false;
+  ctx->is_default = false;
+  ctx->shared_slew = false;
+  ctx->measured_drift = false;
+  ctx->provider_slew = false;
+  ctx->drift_estimation = false;
+  ctx->coalesce = false;
+  ctx->tick_running = false;
+  ctx->standby = false;
 
   /* Make sure the compiler doesn't re-order the above memory accesses
      such that they occur after we've already torn down the jump context. */
@@ -169,7 +239,7 @@ fail_unmap:
   saved_errno = errno;
   ret = pthread_setspecific(sigbus_key, NULL);
   assert(ret == 0);
-  ret = munmap(ctx->timedata, sizeof(timedata));
+  ret = munmap(ctx->timedata, ctx->map_len);
   assert(ret == 0);
   errno = saved_errno;
 fail_close:
@@ -181,9 +251,71 @@ fail_free_ctx:
   return NULL;
 }
 
-static int get_and_validate_entry(byztime_ctx *ctx, timedata_entry *entry) {
+static _Atomic(byztime_ctx *) default_ctx = NULL;
+
+byztime_ctx *byztime_default_ctx(void) {
+  byztime_ctx *ctx, *new_ctx;
+  char const *pathname;
+
+  ctx = atomic_load_explicit(&default_ctx, memory_order_acquire);
+  if (ctx != NULL) return ctx;
+
+  pathname = getenv(BYZTIME_DEFAULT_PATH_ENV);
+  if (pathname == NULL || *pathname == '\0') pathname = BYZTIME_DEFAULT_PATH;
+
+  new_ctx = byztime_open_ro(pathname);
+  if (new_ctx == NULL) return NULL;
+  new_ctx->is_default = true;
+
+  /* Publish our context unless another thread beat us to it, in which
+     case we discard ours and use theirs. Nothing here can be left
+     half-done by a fork() in another thread, so the child needs no
+     atfork handling. */
+  if (atomic_compare_exchange_strong_explicit(&default_ctx, &ctx, new_ctx,
+                                              memory_order_acq_rel,
+                                              memory_order_acquire)) {
+    return new_ctx;
+  }
+
+  new_ctx->is_default = false;
+  byztime_close(new_ctx);
+  return ctx;
+}
+
+/* Copies the current entry into `entry`, and if `aux` is non-NULL, the
+   auxiliary record that goes with it into `aux`. If there is no valid
+   auxiliary record, `aux` is zeroed. The caller must have registered a
+   jump context for the SIGBUS handler. Returns 0 or EPROTO, without
+   touching errno, so that it can serve the async-signal-safe read path
+   too. */
+static int copy_entry(byztime_ctx const *ctx, timedata_entry *entry,
+                      timedata_aux *aux) {
+  int i = atomic_load_explicit(&ctx->timedata->i, memory_order_consume);
+  if (i < 0 || i >= NUM_ENTRIES) return EPROTO;
+
+  memcpy(entry, &ctx->timedata->entries[i], sizeof(timedata_entry));
+  if (aux != NULL) {
+    if (ctx->ext != NULL && entry->seq != 0) {
+      memcpy(aux, &ctx->ext->aux[i], sizeof(timedata_aux));
+      if (aux->seq != entry->seq) memset(aux, 0, sizeof(timedata_aux));
+    } else {
+      memset(aux, 0, sizeof(timedata_aux));
+    }
+  }
+
+  if (entry->offset.nanoseconds < 0 || entry->offset.nanoseconds >= billion ||
+      entry->error.nanoseconds < 0 || entry->error.nanoseconds >= billion ||
+      entry->as_of.nanoseconds < 0 || entry->as_of.nanoseconds >= billion) {
+    return EPROTO;
+  }
+
+  return 0;
+}
+
+static int get_and_validate_entry(byztime_ctx *ctx, timedata_entry *entry,
+                                  timedata_aux *aux) {
   sigjmp_buf jmpbuf;
-  int ret;
+  int ret, copy_ret;
 
   if (sigsetjmp(jmpbuf, 0) != 0) {
     errno = EPROTO;
@@ -198,46 +330,322 @@ static int get_and_validate_entry(byztime_ctx *ctx, timedata_entry *entry) {
 
   atomic_signal_fence(memory_order_acq_rel);
 
-  int i = atomic_load_explicit(&ctx->timedata->i, memory_order_consume);
-  if (i < 0 || i >= NUM_ENTRIES) {
-    atomic_signal_fence(memory_order_acq_rel);
-    ret = pthread_setspecific(sigbus_key, NULL);
-    assert(ret == 0);
-    errno = EPROTO;
+  copy_ret = copy_entry(ctx, entry, aux);
+
+  atomic_signal_fence(memory_order_acq_rel);
+  ret = pthread_setspecific(sigbus_key, NULL);
+  assert(ret == 0);
+
+  if (copy_ret != 0) {
+    errno = copy_ret;
     return -1;
   }
+  return 0;
+}
 
-  memcpy(entry, &ctx->timedata->entries[i], sizeof(timedata_entry));
+/* Reads the local clock using the source selected for `ctx`. If that is
+   CLOCK_MONOTONIC, the reading is converted using the sample in `aux`
+   and the error this introduces is returned in `extra_error`. */
+static int read_local_time(byztime_ctx const *ctx, timedata_aux const *aux,
+                           byztime_stamp *local_time, int64_t *extra_error) {
+  struct timespec ts;
+  int64_t raw_ns;
 
-  if (entry->offset.nanoseconds < 0 || entry->offset.nanoseconds >= billion ||
-      entry->error.nanoseconds < 0 || entry->error.nanoseconds >= billion ||
-      entry->as_of.nanoseconds < 0 || entry->as_of.nanoseconds >= billion) {
-    atomic_signal_fence(memory_order_acq_rel);
-    ret = pthread_setspecific(sigbus_key, NULL);
-    assert(ret == 0);
+  if (ctx->local_clock != BYZTIME_LOCAL_CLOCK_MONOTONIC || aux == NULL ||
+      aux->mono_err <= 0 || aux->mono_rate_ppb > max_mono_adj_ppb ||
+      aux->mono_rate_ppb < -max_mono_adj_ppb) {
+    *extra_error = 0;
+    return byztime_get_local_time(local_time);
+  }
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) return -1;
+  aux_mono_to_raw(aux, (int64_t)ts.tv_sec * billion + ts.tv_nsec, &raw_ns,
+                  extra_error);
+  ns_to_stamp(local_time, raw_ns);
+  return 0;
+}
+
+int byztime_set_local_clock(byztime_ctx *ctx, int clock) {
+  if (ctx->is_default) {
+    errno = EPERM;
+    return -1;
+  }
+
+  switch (clock) {
+  case BYZTIME_LOCAL_CLOCK_AUTO:
+    ctx->local_clock = probe_local_clock();
+    return 0;
+  case BYZTIME_LOCAL_CLOCK_RAW:
+  case BYZTIME_LOCAL_CLOCK_MONOTONIC:
+    ctx->local_clock = clock;
+    return 0;
+  default:
+    errno = EINVAL;
+    return -1;
+  }
+}
+
+int byztime_get_local_clock(byztime_ctx const *ctx) {
+  return ctx->local_clock;
+}
+
+int byztime_get_global_time_signal_safe(byztime_ctx const *ctx,
+                                        byztime_stamp *min,
+                                        byztime_stamp *est,
+                                        byztime_stamp *max) {
+  sigjmp_buf jmpbuf;
+  sigjmp_buf *volatile prev_jmpbuf = signal_safe_jmpbuf;
+  int saved_errno = errno;
+  timedata_entry entry;
+  timedata_aux aux;
+  byztime_stamp local_time;
+  byztime_interval out;
+  int64_t local_ns, clock_error;
+  int ret;
+
+  if (sigsetjmp(jmpbuf, 0) != 0) {
+    signal_safe_jmpbuf = prev_jmpbuf;
+    errno = saved_errno;
+    return EPROTO;
+  }
+
+  signal_safe_jmpbuf = &jmpbuf;
+  atomic_signal_fence(memory_order_acq_rel);
+  ret = copy_entry(ctx, &entry, &aux);
+  atomic_signal_fence(memory_order_acq_rel);
+  signal_safe_jmpbuf = prev_jmpbuf;
+  if (ret != 0) return ret;
+
+  /* Everything below is async-signal-safe but may set errno, so we
+     collect it as our return value and then put back the caller's. */
+  if (read_local_time(ctx, &aux, &local_time, &clock_error) < 0 ||
+      stamp_to_ns(&local_ns, &local_time) < 0 ||
+      byztime_entry_global_time(ctx, &entry, &aux, local_ns - clock_error,
+                                local_ns, local_ns + clock_error, &out) < 0) {
+    ret = errno;
+    errno = saved_errno;
+    return ret;
+  }
+
+  if (min != NULL) *min = out.min;
+  if (est != NULL) *est = out.est;
+  if (max != NULL) *max = out.max;
+  return 0;
+}
+
+int byztime_get_real_offset(byztime_ctx *ctx, byztime_stamp *real_offset) {
+  timedata_entry entry;
+  timedata_aux aux;
+  sigjmp_buf jmpbuf;
+  int ret;
+
+  if (get_and_validate_entry(ctx, &entry, &aux) < 0) return -1;
+  if (aux.has_real_offset) {
+    *real_offset = aux.real_offset;
+    return 0;
+  }
+
+  /* The provider doesn't publish real_offset with its entries, so fall
+     back to the copy in the header. */
+  if (sigsetjmp(jmpbuf, 0) != 0) {
     errno = EPROTO;
     return -1;
   }
 
+  ret = pthread_setspecific(sigbus_key, &jmpbuf);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+
+  atomic_signal_fence(memory_order_acq_rel);
+  memcpy(real_offset, &ctx->timedata->real_offset, sizeof(byztime_stamp));
   atomic_signal_fence(memory_order_acq_rel);
+
   ret = pthread_setspecific(sigbus_key, NULL);
   assert(ret == 0);
+
+  if (real_offset->nanoseconds < 0 || real_offset->nanoseconds >= billion) {
+    errno = EPROTO;
+    return -1;
+  }
+  return 0;
+}
+
+#define TICK_READ_ATTEMPTS 1000
+
+/* How many periods a tick may be late before it is considered stale.
+   The tick thread sleeps to absolute deadlines, so an occasional
+   scheduling delay doesn't accumulate, but it can make a single tick
+   late by much more than the coarse clock's resolution. */
+#define TICK_STALE_PERIODS 4
+
+int byztime_get_global_time_coarse(byztime_ctx const *ctx, int64_t *min,
+                                   int64_t *est, int64_t *max) {
+  sigjmp_buf jmpbuf;
+  sigjmp_buf *volatile prev_jmpbuf = signal_safe_jmpbuf;
+  timedata_tick *tick;
+  uint_fast64_t seq1, seq2;
+  int64_t my_min, my_est, my_max, coarse_ns, period_ns, res_ns, adj_ppb, age;
+  __int128 widen;
+  struct timespec ts;
+
+  if (ctx->ext == NULL) {
+    errno = ENODATA;
+    return -1;
+  }
+  tick = &ctx->ext->tick;
+
+  /* Using the signal-safe jump context keeps this to a couple of
+     thread-local stores. */
+  if (sigsetjmp(jmpbuf, 0) != 0) {
+    signal_safe_jmpbuf = prev_jmpbuf;
+    errno = EPROTO;
+    return -1;
+  }
+  signal_safe_jmpbuf = &jmpbuf;
+  atomic_signal_fence(memory_order_acq_rel);
+
+  /* The provider holds the seqlock only for a few stores, but might
+     have died holding it, so don't retry forever. */
+  for (int attempt = 0;; attempt++) {
+    seq1 = atomic_load_explicit(&tick->seq, memory_order_acquire);
+    my_min = tick->min;
+    my_est = tick->est;
+    my_max = tick->max;
+    coarse_ns = tick->coarse_ns;
+    period_ns = tick->period_ns;
+    res_ns = tick->res_ns;
+    adj_ppb = tick->adj_ppb;
+    atomic_thread_fence(memory_order_acquire);
+    seq2 = atomic_load_explicit(&tick->seq, memory_order_relaxed);
+    if (seq1 == seq2 && !(seq1 & 1)) break;
+    if (attempt == TICK_READ_ATTEMPTS) {
+      atomic_signal_fence(memory_order_acq_rel);
+      signal_safe_jmpbuf = prev_jmpbuf;
+      errno = ESTALE;
+      return -1;
+    }
+  }
+
+  atomic_signal_fence(memory_order_acq_rel);
+  signal_safe_jmpbuf = prev_jmpbuf;
+
+  if (seq1 == 0) {
+    errno = ENODATA;
+    return -1;
+  }
+
+  /* A tick more than a few periods old means the ticker has stopped
+     rather than merely run late. */
+  if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) < 0) return -1;
+  age = (int64_t)ts.tv_sec * billion + ts.tv_nsec - coarse_ns;
+  if (age < 0 || period_ns <= 0 || res_ns < 0 || adj_ppb < max_mono_adj_ppb ||
+      (__int128)age > (__int128)period_ns * TICK_STALE_PERIODS + res_ns) {
+    errno = ESTALE;
+    return -1;
+  }
+
+  /* Global time has only advanced since the tick, so min stands. The
+     coarse clock lags by up to res, so up to age + res of
+     CLOCK_MONOTONIC has elapsed since the tick was computed, which is at
+     most adj_ppb more than that in local time, during which max grows
+     by a little more still. */
+  widen = (__int128)age + res_ns;
+  widen += (widen * (adj_ppb + 2 * (__int128)ctx->drift_ppb) +
+            billion - 1) /
+           billion;
+  if (widen > INT64_MAX ||
+      __builtin_add_overflow(my_max, (int64_t)widen, &my_max)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  if (min != NULL) *min = my_min;
+  if (est != NULL) *est = my_est;
+  if (max != NULL) *max = my_max;
+  return 0;
+}
+
+int byztime_load_entry(byztime_ctx *ctx, timedata_entry *entry,
+                       timedata_aux *aux) {
+  return get_and_validate_entry(ctx, entry, aux);
+}
+
+int byztime_entry_global_time(byztime_ctx const *ctx,
+                              timedata_entry const *entry,
+                              timedata_aux const *aux, int64_t local_min,
+                              int64_t local_est, int64_t local_max,
+                              byztime_interval *out) {
+  int64_t offset_ns, error_ns, as_of_ns, drift_ppb;
+  __int128 age_min, age_max, age, error, min, est, max;
+
+  if (stamp_to_ns(&offset_ns, &entry->offset) < 0 ||
+      stamp_to_ns(&error_ns, &entry->error) < 0 ||
+      stamp_to_ns(&as_of_ns, &entry->as_of) < 0) {
+    return -1;
+  }
+
+  drift_ppb = ctx->drift_ppb;
+  if (ctx->measured_drift && aux->drift_ppb > 0) drift_ppb = aux->drift_ppb;
+
+  age_min = (__int128)local_min - as_of_ns;
+  age_max = (__int128)local_max - as_of_ns;
+  if (age_min < 0) age_min = -age_min;
+  if (age_max < 0) age_max = -age_max;
+  age = age_min > age_max ? age_min : age_max;
+
+  error = error_ns + (age * drift_ppb * 2 + billion - 1) / billion;
+  min = (__int128)local_min + offset_ns - error;
+  max = (__int128)local_max + offset_ns + error;
+  est = (__int128)local_est + offset_ns;
+  if (ctx->shared_slew) est += aux_slew_correction(aux, local_est);
+
+  if (min < INT64_MIN || max > INT64_MAX || est < INT64_MIN ||
+      est > INT64_MAX) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  ns_to_stamp(&out->min, (int64_t)min);
+  ns_to_stamp(&out->est, (int64_t)est);
+  ns_to_stamp(&out->max, (int64_t)max);
   return 0;
 }
 
 void byztime_set_drift(byztime_ctx *ctx, int64_t drift_ppb) {
+  /* The default context is shared by every thread, which reads it
+     without locking, so its drift_ppb and drift_err_mult can't be
+     updated as a pair. */
+  if (ctx->is_default) return;
   ctx->drift_ppb = drift_ppb;
+  ctx->drift_err_mult = drift_ppb_to_err_mult(drift_ppb);
 }
 
 int64_t byztime_get_drift(byztime_ctx const *ctx) {
   return ctx->drift_ppb;
 }
 
+int byztime_use_measured_drift(byztime_ctx *ctx, int enable) {
+  if (ctx->is_default) {
+    errno = EPERM;
+    return -1;
+  }
+
+  ctx->measured_drift = enable != 0;
+  return 0;
+}
+
 int byztime_slew(byztime_ctx *ctx, int64_t min_rate_ppb, int64_t max_rate_ppb,
                  byztime_stamp const *maxerror) {
   timedata_entry entry;
 
-  if (get_and_validate_entry(ctx, &entry) < 0) { return -1; }
+  if (ctx->is_default) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if (get_and_validate_entry(ctx, &entry, NULL) < 0) { return -1; }
 
   if (maxerror != NULL && byztime_stamp_cmp(&entry.error, maxerror) > 0) {
     errno = ERANGE;
@@ -245,87 +653,210 @@ int byztime_slew(byztime_ctx *ctx, int64_t min_rate_ppb, int64_t max_rate_ppb,
   }
 
   ctx->slew_mode = true;
+  ctx->shared_slew = false;
   ctx->slew_have_prev = false;
+  byztime_slew_set_rates(ctx, min_rate_ppb, max_rate_ppb);
+  return 0;
+}
+
+void byztime_slew_set_rates(byztime_ctx *ctx, int64_t min_rate_ppb,
+                            int64_t max_rate_ppb) {
   ctx->min_rate_ppb = min_rate_ppb;
   ctx->max_rate_ppb = max_rate_ppb;
-  return 0;
+  ctx->slew_fast =
+      !__builtin_sub_overflow((int64_t)billion, min_rate_ppb,
+                              &ctx->slew_min_coef) &&
+      !__builtin_sub_overflow(max_rate_ppb, (int64_t)billion,
+                              &ctx->slew_max_coef);
 }
 
 int byztime_step(byztime_ctx *ctx) {
+  if (ctx->is_default) return 0;
+  ctx->slew_mode = false;
+  ctx->shared_slew = false;
+  return 0;
+}
+
+int byztime_slew_shared(byztime_ctx *ctx) {
+  if (ctx->is_default) {
+    errno = EPERM;
+    return -1;
+  }
+
   ctx->slew_mode = false;
+  ctx->shared_slew = true;
+  return 0;
+}
+
+/* Computes a - b in nanoseconds, failing on any overflow. */
+static inline bool diff_ns(int64_t *ns, byztime_stamp const *a,
+                           byztime_stamp const *b) {
+  int64_t seconds, nanoseconds;
+  return !__builtin_sub_overflow(a->seconds, b->seconds, &seconds) &&
+         !__builtin_sub_overflow(a->nanoseconds, b->nanoseconds,
+                                 &nanoseconds) &&
+         !__builtin_mul_overflow(seconds, (int64_t)billion, ns) &&
+         !__builtin_add_overflow(*ns, nanoseconds, ns);
+}
+
+/* Decides cheaply whether a slewing read can skip the clamp.
+
+   With g the global time elapsed since the previous read, in
+   nanoseconds, the full computation below clamps the estimate if
+   g < round(g * min_rate / billion), or if g > round(g * max_rate /
+   billion). The exact products differ from g by -g * slew_min_coef /
+   billion and +g * slew_max_coef / billion. byztime_stamp_scale() rounds
+   correctly, hence monotonically, and g is an integer, so whenever
+   g * slew_min_coef >= 0 the first rounded product can't exceed g, and
+   likewise for the second. That makes the test one multiplication and
+   sign check per side, and it passes for every read in which global time
+   moves forward at all. Returns false whenever it can't be sure,
+   including on any overflow. The local and offset differences are
+   bounded separately, as the full computation forms them, so that none
+   of its stamp operations can overflow either. The caller then does the
+   full computation. */
+static bool slew_unclamped(byztime_ctx const *ctx,
+                           byztime_stamp const *local_time,
+                           byztime_stamp const *offset) {
+  int64_t local_ns, offset_ns, g, p;
+
+  if (!ctx->slew_fast) return false;
+
+  if (!diff_ns(&local_ns, local_time, &ctx->prev_local_time) ||
+      !diff_ns(&offset_ns, offset, &ctx->prev_offset) ||
+      __builtin_add_overflow(local_ns, offset_ns, &g))
+    return false;
+
+  if (__builtin_mul_overflow(g, ctx->slew_min_coef, &p) || p < 0)
+    return false;
+
+  if (ctx->max_rate_ppb < INT64_MAX &&
+      (__builtin_mul_overflow(g, ctx->slew_max_coef, &p) || p < 0))
+    return false;
+
+  return true;
+}
+
+/* Computes the estimate of a slewing read at `local_time` of an entry
+   with offset `offset`: the offset, clamped so that global time has
+   advanced since the previous read at a rate between min_rate_ppb and
+   max_rate_ppb. */
+static int slew_clamp(byztime_ctx const *ctx, byztime_stamp const *local_time,
+                      byztime_stamp const *offset, byztime_stamp *est) {
+  byztime_stamp local_time_since_prev, offset_adj_since_prev,
+      global_time_since_prev, min_global_time_since_prev,
+      max_global_time_since_prev;
+
+  if (byztime_stamp_sub(&local_time_since_prev, local_time,
+                        &ctx->prev_local_time) < 0 ||
+      byztime_stamp_sub(&offset_adj_since_prev, offset, &ctx->prev_offset) <
+          0 ||
+      byztime_stamp_add(&global_time_since_prev, &local_time_since_prev,
+                        &offset_adj_since_prev) < 0 ||
+      byztime_stamp_scale(&min_global_time_since_prev,
+                          &global_time_since_prev, ctx->min_rate_ppb) < 0 ||
+      (ctx->max_rate_ppb < INT64_MAX &&
+       byztime_stamp_scale(&max_global_time_since_prev,
+                           &global_time_since_prev,
+                           ctx->max_rate_ppb) < 0)) {
+    return -1;
+  }
+
+  if (byztime_stamp_cmp(&global_time_since_prev,
+                        &min_global_time_since_prev) < 0) {
+    byztime_stamp shortfall_global_time_since_prev;
+    if (byztime_stamp_sub(&shortfall_global_time_since_prev,
+                          &min_global_time_since_prev,
+                          &global_time_since_prev) < 0 ||
+        byztime_stamp_add(est, offset, &shortfall_global_time_since_prev) <
+            0) {
+      return -1;
+    }
+  } else if (ctx->max_rate_ppb < INT64_MAX &&
+             byztime_stamp_cmp(&global_time_since_prev,
+                               &max_global_time_since_prev) > 0) {
+    byztime_stamp excess_global_time_since_prev;
+    if (byztime_stamp_sub(&excess_global_time_since_prev,
+                          &global_time_since_prev,
+                          &max_global_time_since_prev) < 0 ||
+        byztime_stamp_sub(est, offset, &excess_global_time_since_prev) < 0) {
+      return -1;
+    }
+  } else {
+    *est = *offset;
+  }
   return 0;
 }
 
+bool byztime_slew_unclamped(byztime_ctx const *ctx,
+                            byztime_stamp const *local_time,
+                            byztime_stamp const *offset) {
+  return slew_unclamped(ctx, local_time, offset);
+}
+
+int byztime_slew_clamp(byztime_ctx const *ctx, byztime_stamp const *local_time,
+                       byztime_stamp const *offset, byztime_stamp *est) {
+  return slew_clamp(ctx, local_time, offset, est);
+}
+
+/* Computes the offset as of local time `at`, or if `at` is NULL, as of
+   a fresh reading of the local clock taken after loading the entry. The
+   local time used is returned in `local_time`. */
 static int byztime_get_local_time_and_offset(byztime_ctx *ctx,
+                                             byztime_stamp const *at,
                                              byztime_stamp *local_time,
                                              byztime_stamp *min,
                                              byztime_stamp *est,
                                              byztime_stamp *max) {
   timedata_entry entry;
-  byztime_stamp my_local_time, error, age, scaled_age;
+  timedata_aux aux;
+  byztime_stamp my_local_time, error, age, scaled_age, clock_error;
   byztime_stamp my_min, my_max, my_est;
 
-  int64_t drift_ppb_x2;
+  int64_t drift_ppb, drift_ppb_x2, clock_error_ns = 0;
+  bool want_aux = ctx->shared_slew || ctx->measured_drift ||
+                  ctx->local_clock == BYZTIME_LOCAL_CLOCK_MONOTONIC;
+
+  if (get_and_validate_entry(ctx, &entry, want_aux ? &aux : NULL) < 0) {
+    return -1;
+  }
+
+  drift_ppb = ctx->drift_ppb;
+  if (ctx->measured_drift && aux.drift_ppb > 0) drift_ppb = aux.drift_ppb;
 
-  if (__builtin_mul_overflow(ctx->drift_ppb, 2, &drift_ppb_x2)) {
+  if (__builtin_mul_overflow(drift_ppb, 2, &drift_ppb_x2)) {
     errno = EOVERFLOW;
     return -1;
   }
 
-  if (get_and_validate_entry(ctx, &entry) < 0 ||
-      byztime_get_local_time(&my_local_time) < 0 ||
-      byztime_stamp_sub(&age, &my_local_time, &entry.as_of) < 0 ||
+  if (at != NULL) {
+    my_local_time = *at;
+  } else if (read_local_time(ctx, want_aux ? &aux : NULL, &my_local_time,
+                             &clock_error_ns) < 0) {
+    return -1;
+  }
+  ns_to_stamp(&clock_error, clock_error_ns);
+
+  /* A caller-supplied local time may precede the entry, in which case
+     the error grows backward from as_of just as it does forward. */
+  if (byztime_stamp_sub(&age, &my_local_time, &entry.as_of) < 0 ||
+      (age.seconds < 0 && byztime_stamp_sub(&age, &zerostamp, &age) < 0) ||
       byztime_stamp_scale(&scaled_age, &age, drift_ppb_x2) < 0 ||
       byztime_stamp_add(&error, &entry.error, &scaled_age) < 0 ||
+      byztime_stamp_add(&error, &error, &clock_error) < 0 ||
       byztime_stamp_sub(&my_min, &entry.offset, &error) < 0 ||
       byztime_stamp_add(&my_max, &entry.offset, &error) < 0) {
     return -1;
   }
 
   if (ctx->slew_mode) {
-    if (ctx->slew_have_prev) {
-      byztime_stamp local_time_since_prev, offset_adj_since_prev,
-          global_time_since_prev, min_global_time_since_prev,
-          max_global_time_since_prev;
-      if (byztime_stamp_sub(&local_time_since_prev, &my_local_time,
-                            &ctx->prev_local_time) < 0 ||
-          byztime_stamp_sub(&offset_adj_since_prev, &entry.offset,
-                            &ctx->prev_offset) < 0 ||
-          byztime_stamp_add(&global_time_since_prev, &local_time_since_prev,
-                            &offset_adj_since_prev) < 0 ||
-          byztime_stamp_scale(&min_global_time_since_prev,
-                              &global_time_since_prev, ctx->min_rate_ppb) < 0 ||
-          (ctx->max_rate_ppb < INT64_MAX &&
-           byztime_stamp_scale(&max_global_time_since_prev,
-                               &global_time_since_prev,
-                               ctx->max_rate_ppb) < 0)) {
+    if (ctx->slew_have_prev &&
+        slew_unclamped(ctx, &my_local_time, &entry.offset)) {
+      my_est = entry.offset;
+    } else if (ctx->slew_have_prev) {
+      if (slew_clamp(ctx, &my_local_time, &entry.offset, &my_est) < 0) {
         return -1;
       }
-
-      if (byztime_stamp_cmp(&global_time_since_prev,
-                            &min_global_time_since_prev) < 0) {
-        byztime_stamp shortfall_global_time_since_prev;
-        if (byztime_stamp_sub(&shortfall_global_time_since_prev,
-                              &min_global_time_since_prev,
-                              &global_time_since_prev) < 0 ||
-            byztime_stamp_add(&my_est, &entry.offset,
-                              &shortfall_global_time_since_prev) < 0) {
-          return -1;
-        }
-      } else if (ctx->max_rate_ppb < INT64_MAX &&
-                 byztime_stamp_cmp(&global_time_since_prev,
-                                   &max_global_time_since_prev) > 0) {
-        byztime_stamp excess_global_time_since_prev;
-        if (byztime_stamp_sub(&excess_global_time_since_prev,
-                              &global_time_since_prev,
-                              &max_global_time_since_prev) < 0 ||
-            byztime_stamp_sub(&my_est, &entry.offset,
-                              &excess_global_time_since_prev) < 0) {
-          return -1;
-        }
-      } else {
-        my_est = entry.offset;
-      }
     } else {
       my_est = entry.offset;
     }
@@ -333,6 +864,12 @@ static int byztime_get_local_time_and_offset(byztime_ctx *ctx,
     ctx->prev_local_time = my_local_time;
     ctx->prev_offset = my_est;
     ctx->slew_have_prev = true;
+  } else if (ctx->shared_slew) {
+    int64_t local_ns;
+    byztime_stamp correction;
+    if (stamp_to_ns(&local_ns, &my_local_time) < 0) return -1;
+    ns_to_stamp(&correction, aux_slew_correction(&aux, local_ns));
+    if (byztime_stamp_add(&my_est, &entry.offset, &correction) < 0) return -1;
   } else {
     my_est = entry.offset;
   }
@@ -346,15 +883,15 @@ static int byztime_get_local_time_and_offset(byztime_ctx *ctx,
 
 int byztime_get_offset(byztime_ctx *ctx, byztime_stamp *min, byztime_stamp *est,
                        byztime_stamp *max) {
-  return byztime_get_local_time_and_offset(ctx, NULL, min, est, max);
+  return byztime_get_local_time_and_offset(ctx, NULL, NULL, min, est, max);
 }
 
 int byztime_get_global_time(byztime_ctx *ctx, byztime_stamp *min,
                             byztime_stamp *est, byztime_stamp *max) {
   byztime_stamp local_time, my_min, my_est, my_max;
 
-  if (byztime_get_local_time_and_offset(ctx, &local_time, &my_min, &my_est,
-                                        &my_max) < 0 ||
+  if (byztime_get_local_time_and_offset(ctx, NULL, &local_time, &my_min,
+                                        &my_est, &my_max) < 0 ||
       byztime_stamp_add(&my_min, &my_min, &local_time) < 0 ||
       byztime_stamp_add(&my_est, &my_est, &local_time) < 0 ||
       byztime_stamp_add(&my_max, &my_max, &local_time) < 0) {
@@ -366,3 +903,203 @@ int byztime_get_global_time(byztime_ctx *ctx, byztime_stamp *min,
   if (max != NULL) *max = my_max;
   return 0;
 }
+
+/* Bounds the global time elapsed since local time `start`, given that
+   the local clock drifts by at most `drift_ppb`. */
+static int elapsed_since(byztime_stamp const *start, int64_t drift_ppb,
+                         byztime_stamp *min, byztime_stamp *est,
+                         byztime_stamp *max) {
+  byztime_stamp now, elapsed, abs_elapsed, margin, my_min, my_max;
+  static const byztime_stamp one_ns = {0, 1};
+
+  if (byztime_get_local_time(&now) < 0 ||
+      byztime_stamp_sub(&elapsed, &now, start) < 0) {
+    return -1;
+  }
+
+  abs_elapsed = elapsed;
+  if (elapsed.seconds < 0 &&
+      byztime_stamp_sub(&abs_elapsed, &zerostamp, &elapsed) < 0) {
+    return -1;
+  }
+
+  /* Round the margin up, since byztime_stamp_scale() rounds to nearest. */
+  if (byztime_stamp_scale(&margin, &abs_elapsed, drift_ppb) < 0 ||
+      byztime_stamp_add(&margin, &margin, &one_ns) < 0 ||
+      byztime_stamp_sub(&my_min, &elapsed, &margin) < 0 ||
+      byztime_stamp_add(&my_max, &elapsed, &margin) < 0) {
+    return -1;
+  }
+
+  if (min != NULL) *min = my_min;
+  if (est != NULL) *est = elapsed;
+  if (max != NULL) *max = my_max;
+  return 0;
+}
+
+int byztime_elapsed(byztime_ctx const *ctx, byztime_stamp const *start_local,
+                    byztime_stamp *min, byztime_stamp *est,
+                    byztime_stamp *max) {
+  return elapsed_since(start_local, ctx->drift_ppb, min, est, max);
+}
+
+int byztime_stopwatch_start(byztime_ctx const *ctx,
+                            byztime_stopwatch *stopwatch) {
+  stopwatch->drift_ppb = ctx->drift_ppb;
+  return byztime_get_local_time(&stopwatch->start);
+}
+
+int byztime_stopwatch_read(byztime_stopwatch const *stopwatch,
+                           byztime_stamp *min, byztime_stamp *est,
+                           byztime_stamp *max) {
+  return elapsed_since(&stopwatch->start, stopwatch->drift_ppb, min, est, max);
+}
+
+int byztime_get_global_time_multi(byztime_ctx *const ctx[], size_t n,
+                                  byztime_interval out[]) {
+  byztime_stamp local_time;
+
+  if (byztime_get_local_time(&local_time) < 0) return -1;
+
+  for (size_t k = 0; k < n; k++) {
+    byztime_interval *o = &out[k];
+    if (byztime_get_local_time_and_offset(ctx[k], &local_time, NULL, &o->min,
+                                          &o->est, &o->max) < 0 ||
+        byztime_stamp_add(&o->min, &o->min, &local_time) < 0 ||
+        byztime_stamp_add(&o->est, &o->est, &local_time) < 0 ||
+        byztime_stamp_add(&o->max, &o->max, &local_time) < 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/* Fallback for byztime_get_global_time_ns() when the provider publishes
+   no linear model: the same computation as in step mode, on stamps. */
+static int get_global_time_ns_slow(timedata_entry const *entry,
+                                   byztime_stamp const *local_time,
+                                   int64_t drift_ppb, int64_t *min,
+                                   int64_t *est, int64_t *max) {
+  byztime_stamp age, scaled_age, error, global;
+  int64_t drift_ppb_x2, global_ns, error_ns;
+
+  if (__builtin_mul_overflow(drift_ppb, 2, &drift_ppb_x2)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  if (byztime_stamp_sub(&age, local_time, &entry->as_of) < 0 ||
+      (age.seconds < 0 && byztime_stamp_sub(&age, &zerostamp, &age) < 0) ||
+      byztime_stamp_scale(&scaled_age, &age, drift_ppb_x2) < 0 ||
+      byztime_stamp_add(&error, &entry->error, &scaled_age) < 0 ||
+      byztime_stamp_add(&global, local_time, &entry->offset) < 0 ||
+      stamp_to_ns(&global_ns, &global) < 0 ||
+      stamp_to_ns(&error_ns, &error) < 0) {
+    return -1;
+  }
+
+  if (__builtin_sub_overflow(global_ns, error_ns, min) ||
+      __builtin_add_overflow(global_ns, error_ns, max)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  *est = global_ns;
+  return 0;
+}
+
+/* Evaluates the linear model published in `aux` at local time
+   `local_ns`, read with error `clock_error`. The error grows with the
+   magnitude of the age, as in byztime_entry_global_time(), since a
+   local time may precede as_of. */
+static inline int linear_global_time_ns(byztime_ctx const *ctx,
+                                        timedata_aux const *aux,
+                                        int64_t local_ns, int64_t clock_error,
+                                        int64_t *min, int64_t *est,
+                                        int64_t *max) {
+  int64_t center, error;
+  uint64_t err_mult;
+  __int128 age, growth;
+
+  err_mult = ctx->drift_err_mult;
+  if (ctx->measured_drift && aux->err_mult != 0) err_mult = aux->err_mult;
+
+  age = (__int128)local_ns - aux->as_of_ns;
+  if (age < 0) age = -age;
+
+  /* The +1 makes up for truncation by the shift. */
+  growth = (age * err_mult >> ERR_MULT_SHIFT) + 1 + clock_error;
+  if (growth > INT64_MAX ||
+      __builtin_add_overflow(local_ns, aux->offset_ns, &center) ||
+      __builtin_add_overflow(aux->error_ns, (int64_t)growth, &error) ||
+      __builtin_sub_overflow(center, error, min) ||
+      __builtin_add_overflow(center, error, max)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  if (local_ns < aux->lin_until) {
+    *est = aux->lin_base +
+           (int64_t)((__int128)(local_ns - aux->lin_ref) * aux->lin_mult >>
+                     aux->lin_shift);
+  } else {
+    *est = center;
+  }
+
+  return 0;
+}
+
+int byztime_entry_global_time_linear_ns(byztime_ctx const *ctx,
+                                        timedata_aux const *aux,
+                                        int64_t local_ns, int64_t clock_error,
+                                        int64_t *min, int64_t *est,
+                                        int64_t *max) {
+  return linear_global_time_ns(ctx, aux, local_ns, clock_error, min, est,
+                               max);
+}
+
+int byztime_entry_global_time_now_ns(byztime_ctx const *ctx,
+                                     timedata_entry const *entry,
+                                     timedata_aux const *aux,
+                                     int64_t *local_ns, int64_t *min,
+                                     int64_t *est, int64_t *max) {
+  byztime_stamp local_time;
+  int64_t clock_error;
+
+  if (aux->lin_mult == 0) {
+    int64_t drift_ppb = ctx->drift_ppb;
+    if (ctx->measured_drift && aux->drift_ppb > 0) drift_ppb = aux->drift_ppb;
+    if (byztime_get_local_time(&local_time) < 0 ||
+        stamp_to_ns(local_ns, &local_time) < 0) {
+      return -1;
+    }
+    return get_global_time_ns_slow(entry, &local_time, drift_ppb, min, est,
+                                   max);
+  }
+
+  if (read_local_time(ctx, aux, &local_time, &clock_error) < 0 ||
+      stamp_to_ns(local_ns, &local_time) < 0) {
+    return -1;
+  }
+
+  return linear_global_time_ns(ctx, aux, *local_ns, clock_error, min, est,
+                               max);
+}
+
+int byztime_get_global_time_ns(byztime_ctx *ctx, int64_t *min, int64_t *est,
+                               int64_t *max) {
+  timedata_entry entry;
+  timedata_aux aux;
+  int64_t local_ns, my_min, my_est, my_max;
+
+  if (get_and_validate_entry(ctx, &entry, &aux) < 0 ||
+      byztime_entry_global_time_now_ns(ctx, &entry, &aux, &local_ns, &my_min,
+                                       &my_est, &my_max) < 0) {
+    return -1;
+  }
+
+  if (min != NULL) *min = my_min;
+  if (est != NULL) *est = my_est;
+  if (max != NULL) *max = my_max;
+  return 0;
+}
@@ -0,0 +1,353 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _GNU_SOURCE
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Sparse time index.
+
+   A log segment is a sequence of records, each stamped with an
+   interval of global time. The records are in append order, which is
+   nearly but not exactly time order: intervals from different threads
+   or hosts overlap and interleave. The index divides the segment into
+   blocks of `stride` records and stores, for each block, its starting
+   byte offset and two stamps:
+
+     - suffix_min, the least `min` of any record in this block or later;
+     - prefix_max, the greatest `max` of any record in this block or
+       earlier.
+
+   Both are monotonically non-decreasing in block number no matter how
+   the records interleave, so each end of a query range can be found by
+   binary search. Any record whose interval meets [lo, hi] has
+   max >= lo and min <= hi, and so lies in a block at or after the first
+   with prefix_max >= lo and at or before the last with
+   suffix_min <= hi. Neither property can be computed until the segment
+   is complete, which is why the index is written once, at finish, and
+   is read-only thereafter.
+
+   Everything is stored in host byte order. */
+
+static const unsigned char expected_index_magic[BYZTIME_MAGIC_LEN] = {
+    'B', 'Y', 'Z', 'T', 'I', 'M', 'E', 'I', 0x01, 0x00, 0x00, 0x00};
+
+/* Written as 0x01020304 so that a reader on a host of the other byte
+   order sees something else and rejects the file. */
+static const uint32_t index_byte_order = 0x01020304;
+
+typedef struct index_header_s {
+  unsigned char magic[BYZTIME_MAGIC_LEN];
+  uint32_t byte_order;
+  uint32_t stride;
+  uint32_t reserved0;
+  uint64_t nblocks;
+  uint64_t nrecords;
+  uint64_t end_offset;
+  uint64_t reserved[2];
+} index_header;
+
+typedef struct index_block_s {
+  uint64_t offset;
+  byztime_stamp suffix_min;
+  byztime_stamp prefix_max;
+} index_block;
+
+_Static_assert(sizeof(index_header) == 64, "index_header is not 64 bytes");
+_Static_assert(sizeof(index_block) == 40, "index_block is not 40 bytes");
+
+struct byztime_index_writer_s {
+  char *path;
+  uint32_t stride;
+  uint32_t in_block;
+  uint64_t nrecords;
+  uint64_t last_offset;
+  size_t nblocks;
+  size_t cap;
+  /* While building, suffix_min and prefix_max hold the block's own
+     minimum and maximum; they become running bounds in finish. */
+  index_block *blocks;
+};
+
+struct byztime_index_s {
+  index_header const *header;
+  index_block const *blocks;
+  size_t map_len;
+};
+
+byztime_index_writer *byztime_index_create(char const *path, uint32_t stride) {
+  byztime_index_writer *w;
+
+  if (stride == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  w = malloc(sizeof(byztime_index_writer));
+  if (w == NULL) return NULL;
+  memset(w, 0, sizeof *w);
+
+  w->path = strdup(path);
+  if (w->path == NULL) {
+    free(w);
+    return NULL;
+  }
+  w->stride = stride;
+  return w;
+}
+
+int byztime_index_add(byztime_index_writer *w, uint64_t offset,
+                      byztime_stamp const *min, byztime_stamp const *max) {
+  index_block *block;
+
+  if (w->nrecords != 0 && offset <= w->last_offset) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (w->in_block == 0) {
+    if (w->nblocks == w->cap) {
+      size_t cap = w->cap ? 2 * w->cap : 64;
+      size_t bytes;
+      index_block *blocks;
+
+      if (__builtin_mul_overflow(cap, sizeof(index_block), &bytes)) {
+        errno = ENOMEM;
+        return -1;
+      }
+      blocks = realloc(w->blocks, bytes);
+      if (blocks == NULL) return -1;
+      w->blocks = blocks;
+      w->cap = cap;
+    }
+
+    block = &w->blocks[w->nblocks++];
+    block->offset = offset;
+    block->suffix_min = *min;
+    block->prefix_max = *max;
+  } else {
+    block = &w->blocks[w->nblocks - 1];
+    if (byztime_stamp_cmp(min, &block->suffix_min) < 0)
+      block->suffix_min = *min;
+    if (byztime_stamp_cmp(max, &block->prefix_max) > 0)
+      block->prefix_max = *max;
+  }
+
+  if (++w->in_block == w->stride) w->in_block = 0;
+  w->nrecords++;
+  w->last_offset = offset;
+  return 0;
+}
+
+static int write_fully(int fd, void const *buf, size_t len) {
+  char const *p = buf;
+
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+int byztime_index_finish(byztime_index_writer *w, uint64_t end_offset) {
+  index_header header;
+  char *tmp_path = NULL;
+  int fd = -1, saved_errno, ret = -1;
+
+  if (w->nrecords != 0 && end_offset <= w->last_offset) {
+    errno = EINVAL;
+    goto out;
+  }
+
+  for (size_t k = 1; k < w->nblocks; k++) {
+    if (byztime_stamp_cmp(&w->blocks[k].prefix_max,
+                          &w->blocks[k - 1].prefix_max) < 0)
+      w->blocks[k].prefix_max = w->blocks[k - 1].prefix_max;
+  }
+  for (size_t k = w->nblocks; k > 1; k--) {
+    if (byztime_stamp_cmp(&w->blocks[k - 2].suffix_min,
+                          &w->blocks[k - 1].suffix_min) > 0)
+      w->blocks[k - 2].suffix_min = w->blocks[k - 1].suffix_min;
+  }
+
+  memset(&header, 0, sizeof header);
+  memcpy(header.magic, expected_index_magic, sizeof header.magic);
+  header.byte_order = index_byte_order;
+  header.stride = w->stride;
+  header.nblocks = w->nblocks;
+  header.nrecords = w->nrecords;
+  header.end_offset = end_offset;
+
+  /* Write to a temporary file and rename it into place, so that readers
+     see either no index or a complete one. */
+  if (asprintf(&tmp_path, "%s.XXXXXX", w->path) < 0) {
+    tmp_path = NULL;
+    goto out;
+  }
+  fd = mkostemp(tmp_path, O_CLOEXEC);
+  if (fd < 0) goto out;
+
+  if (write_fully(fd, &header, sizeof header) < 0 ||
+      write_fully(fd, w->blocks, w->nblocks * sizeof(index_block)) < 0 ||
+      fchmod(fd, 0644) < 0 || fsync(fd) < 0)
+    goto fail_unlink;
+
+  if (close(fd) < 0) {
+    fd = -1;
+    goto fail_unlink;
+  }
+  fd = -1;
+
+  if (rename(tmp_path, w->path) < 0) goto fail_unlink;
+  ret = 0;
+  goto out;
+
+fail_unlink:
+  saved_errno = errno;
+  if (fd >= 0) close(fd);
+  fd = -1;
+  unlink(tmp_path);
+  errno = saved_errno;
+out:
+  free(tmp_path);
+  byztime_index_abort(w);
+  return ret;
+}
+
+void byztime_index_abort(byztime_index_writer *w) {
+  if (w == NULL) return;
+  free(w->blocks);
+  free(w->path);
+  free(w);
+}
+
+byztime_index *byztime_index_open(char const *path) {
+  byztime_index *idx;
+  struct stat statbuf;
+  index_header const *header;
+  uint64_t expected_len;
+  void *map;
+  int fd, saved_errno;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) return NULL;
+
+  if (fstat(fd, &statbuf) < 0) goto fail_close;
+  if (statbuf.st_size < (off_t)sizeof(index_header) ||
+      (uint64_t)statbuf.st_size > SIZE_MAX) {
+    errno = EPROTO;
+    goto fail_close;
+  }
+
+  map = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) goto fail_close;
+  close(fd);
+
+  header = map;
+  if (memcmp(header->magic, expected_index_magic, sizeof header->magic) ||
+      header->byte_order != index_byte_order || header->stride == 0 ||
+      __builtin_mul_overflow(header->nblocks, (uint64_t)sizeof(index_block),
+                             &expected_len) ||
+      __builtin_add_overflow(expected_len, (uint64_t)sizeof(index_header),
+                             &expected_len) ||
+      expected_len != (uint64_t)statbuf.st_size) {
+    errno = EPROTO;
+    goto fail_unmap;
+  }
+
+  idx = malloc(sizeof(byztime_index));
+  if (idx == NULL) goto fail_unmap;
+  idx->header = header;
+  idx->blocks = (index_block const *)(header + 1);
+  idx->map_len = (size_t)statbuf.st_size;
+  return idx;
+
+fail_unmap:
+  saved_errno = errno;
+  munmap(map, (size_t)statbuf.st_size);
+  errno = saved_errno;
+  return NULL;
+
+fail_close:
+  saved_errno = errno;
+  close(fd);
+  errno = saved_errno;
+  return NULL;
+}
+
+int byztime_index_query(byztime_index const *idx, byztime_stamp const *lo,
+                        byztime_stamp const *hi, uint64_t *begin,
+                        uint64_t *end) {
+  index_block const *blocks = idx->blocks;
+  size_t nblocks = (size_t)idx->header->nblocks;
+  size_t first, last, left, right;
+
+  if (byztime_stamp_cmp(lo, hi) > 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* First block with prefix_max >= lo. */
+  left = 0;
+  right = nblocks;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (byztime_stamp_cmp(&blocks[mid].prefix_max, lo) < 0)
+      left = mid + 1;
+    else
+      right = mid;
+  }
+  first = left;
+
+  /* One past the last block with suffix_min <= hi. */
+  left = first;
+  right = nblocks;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (byztime_stamp_cmp(&blocks[mid].suffix_min, hi) <= 0)
+      left = mid + 1;
+    else
+      right = mid;
+  }
+  last = left;
+
+  if (first >= last) {
+    *begin = *end = first < nblocks ? blocks[first].offset
+                                    : idx->header->end_offset;
+    return 0;
+  }
+
+  *begin = blocks[first].offset;
+  *end = last < nblocks ? blocks[last].offset : idx->header->end_offset;
+  return 0;
+}
+
+void byztime_index_get_info(byztime_index const *idx, uint32_t *stride,
+                            uint64_t *nrecords, uint64_t *end_offset) {
+  if (stride != NULL) *stride = idx->header->stride;
+  if (nrecords != NULL) *nrecords = idx->header->nrecords;
+  if (end_offset != NULL) *end_offset = idx->header->end_offset;
+}
+
+int byztime_index_close(byztime_index *idx) {
+  int ret;
+
+  if (idx == NULL) return 0;
+  ret = munmap((void *)idx->header, idx->map_len);
+  free(idx);
+  return ret;
+}
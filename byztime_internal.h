@@ -9,6 +9,7 @@
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 
 #define BYZTIME_MAGIC_LEN 12
 
@@ -26,6 +27,9 @@ typedef struct timedata_entry_s {
       byztime_stamp offset;
       byztime_stamp error;
       byztime_stamp as_of;
+      /* Equal to the `seq` of the timedata_aux record published together
+         with this entry, or zero if there is none. */
+      uint64_t seq;
     };
     char padding[64];
   };
@@ -52,24 +56,254 @@ typedef struct timedata_s {
 _Static_assert(sizeof(timedata) == 4096,
                "timedata is expected to have size 4096");
 
+/* Auxiliary data which newer providers publish alongside each entry.
+   It lives in an extension region which follows the first page of the
+   timedata file, so that the layout of the first page is unchanged and
+   consumers which know nothing of the extension keep working. An aux
+   record is meaningful only if its `seq` is non-zero and equal to that
+   of the entry in the same slot; otherwise it is treated as all-zero,
+   which every field below defines to mean "not published". Older
+   providers zero each entry before writing it, so an aux record can
+   never be mistaken for belonging to an entry that they wrote. */
+typedef struct timedata_aux_s {
+  union {
+    struct {
+      uint64_t seq;
+      /* Provider-side slew. For local times `l` (in nanoseconds) before
+         `slew_end`, the estimated offset is `entry.offset +
+         slew_remaining + (l - slew_start) * slew_rate_ppb / billion`.
+         From `slew_end` onward it is just `entry.offset`. */
+      int64_t slew_start;
+      int64_t slew_end;
+      int64_t slew_remaining;
+      int64_t slew_rate_ppb;
+      /* Conservative bound on local oscillator drift measured by the
+         provider, or zero if it has none. */
+      int64_t drift_ppb;
+      /* Fixed-point linear clock model, in the mult/shift form of the
+         kernel's clocksources. For local times `l` (in nanoseconds)
+         before `lin_until`, the estimated global time is `lin_base +
+         ((l - lin_ref) * lin_mult >> lin_shift)`; from `lin_until`
+         onward it is `l + offset_ns`. Likewise the error bound is
+         `error_ns + ((l - as_of_ns) * err_mult >> ERR_MULT_SHIFT)`.
+         `lin_mult` is zero if there is no model; `err_mult` is zero if
+         there is no measured drift bound. */
+      int64_t lin_ref;
+      int64_t lin_base;
+      uint64_t lin_mult;
+      uint32_t lin_shift;
+      int64_t lin_until;
+      int64_t offset_ns;
+      int64_t error_ns;
+      int64_t as_of_ns;
+      uint64_t err_mult;
+      /* A CLOCK_MONOTONIC reading `mono_ref` paired with the
+         CLOCK_MONOTONIC_RAW reading `raw_ref` taken around it, accurate
+         to within `mono_err` nanoseconds, and the rate of
+         CLOCK_MONOTONIC_RAW relative to CLOCK_MONOTONIC, in parts per
+         billion, as last measured. `mono_err` is zero if there is no
+         sample. */
+      int64_t mono_ref;
+      int64_t raw_ref;
+      int64_t mono_err;
+      int64_t mono_rate_ppb;
+      /* The header's `real_offset` as of this entry's publication, so
+         that consumers can read the two consistently. Meaningful only
+         if `has_real_offset` is non-zero. */
+      byztime_stamp real_offset;
+      uint32_t has_real_offset;
+    };
+    char padding[256];
+  };
+} timedata_aux;
+
+/* The provider's coarse global-time tick, which occupies a cache line
+   of its own. `seq` is a seqlock: odd while the tick is being written,
+   and zero if no tick is running. `min`, `est` and `max` are the global
+   time in nanoseconds as of the CLOCK_MONOTONIC_COARSE reading
+   `coarse_ns`. Ticks happen every `period_ns`, `res_ns` is the
+   resolution of CLOCK_MONOTONIC_COARSE, and `adj_ppb` is
+   byztime_mono_adj_bound_ppb() as of the tick. */
+typedef struct timedata_tick_s {
+  _Alignas(64) atomic_uint_fast64_t seq;
+  int64_t min;
+  int64_t est;
+  int64_t max;
+  int64_t coarse_ns;
+  int64_t period_ns;
+  int64_t res_ns;
+  int64_t adj_ppb;
+} timedata_tick;
+
+typedef struct timedata_ext_s {
+  union {
+    struct {
+      magic magic;
+      /* The `seq` most recently published. Only ever accessed by the
+         provider while holding the mutex. */
+      uint64_t seq;
+      timedata_tick tick;
+    };
+    char padding[512];
+  };
+  timedata_aux aux[NUM_ENTRIES];
+} timedata_ext;
+
+_Static_assert(sizeof(timedata_ext) == 16384,
+               "timedata_ext is expected to have size 16384");
+
+#define ERR_MULT_SHIFT 32
+
+/* Number of past offset measurements retained for drift estimation. */
+#define DRIFT_SAMPLES 16
+
+typedef struct drift_sample_s {
+  int64_t as_of;
+  int64_t offset;
+  int64_t error;
+} drift_sample;
+
 struct byztime_ctx_s {
   int fd, lock_fd;
   timedata __attribute__((aligned(16))) * timedata;
+  /* Points just past `timedata` if the file has a valid extension
+     region, otherwise NULL. */
+  timedata_ext *ext;
+  size_t map_len;
   int64_t drift_ppb;
+  /* drift_ppb_to_err_mult(drift_ppb), cached. */
+  uint64_t drift_err_mult;
 
   int64_t min_rate_ppb;
   int64_t max_rate_ppb;
+  /* billion - min_rate_ppb and max_rate_ppb - billion, precomputed by
+     byztime_slew() for slew_unclamped(). slew_fast is false if either
+     overflowed. */
+  int64_t slew_min_coef;
+  int64_t slew_max_coef;
+  bool slew_fast;
   byztime_stamp prev_local_time;
   byztime_stamp prev_offset;
   bool slew_mode;
   bool slew_have_prev;
+  bool is_default;
+  bool shared_slew;
+  bool measured_drift;
+  int local_clock;
+
+  bool provider_slew;
+  int64_t provider_min_rate_ppb;
+  int64_t provider_max_rate_ppb;
+
+  bool drift_estimation;
+  int64_t drift_window;
+  int drift_nsamples;
+  int drift_head;
+  drift_sample drift_samples[DRIFT_SAMPLES];
+
+  bool mono_have_prev;
+  int64_t mono_prev;
+  int64_t raw_prev;
+  int64_t mono_rate_ppb;
+
+  bool coalesce;
+  int64_t coalesce_threshold;
+  int64_t coalesce_max_interval;
+  uint64_t coalesce_published;
+  uint64_t coalesce_saved;
+
+  bool tick_running;
+  atomic_bool tick_stop;
+  pthread_t tick_thread;
+  int64_t tick_period_ns;
+
+  /* Set for a context opened with byztime_open_standby() until it
+     takes over. `standby_seq` is the seq of the last entry it has
+     absorbed from the primary. */
+  bool standby;
+  uint64_t standby_seq;
 };
 
 static const int64_t default_drift_ppb = 250000;
+/* Bound on how far the kernel's NTP discipline can make the rate of
+   CLOCK_MONOTONIC deviate from that of CLOCK_MONOTONIC_RAW: up to 500 ppm
+   of frequency adjustment plus up to 500 ppm of offset slewing. This
+   excludes adjustments of the tick length (ADJ_TICK), which can add up
+   to 10% more; see byztime_mono_adj_bound_ppb(). */
+static const int64_t max_mono_adj_ppb = 1000000;
+/* The most by which the kernel allows ADJ_TICK to move the tick length
+   from its nominal value. */
+static const int64_t max_tick_adj_ppb = 100000000;
+/* Floor on any drift bound published by the provider's estimator. */
+static const int64_t min_measured_drift_ppb = 1000;
 static const int billion = 1000000000;
 static const unsigned char expected_magic[BYZTIME_MAGIC_LEN] = {
     'B', 'Y', 'Z', 'T', 'I', 'M', 'E', 0x00, 0xff, 0xff, 0xff, 0xff};
 static const byztime_stamp zerostamp = {0, 0};
+static const unsigned char expected_ext_magic[BYZTIME_MAGIC_LEN] = {
+    'B', 'Y', 'Z', 'T', 'I', 'M', 'E', 'X', 0x01, 0x00, 0x00, 0x00};
+
+/* Converts a timestamp to a count of nanoseconds, failing with EOVERFLOW if
+   it does not fit in 64 bits. */
+static inline int stamp_to_ns(int64_t *ns, byztime_stamp const *stamp) {
+  if (__builtin_mul_overflow(stamp->seconds, (int64_t)billion, ns) ||
+      __builtin_add_overflow(*ns, stamp->nanoseconds, ns)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  return 0;
+}
+
+static inline void ns_to_stamp(byztime_stamp *stamp, int64_t ns) {
+  stamp->seconds = ns / billion;
+  stamp->nanoseconds = ns % billion;
+  if (stamp->nanoseconds < 0) {
+    stamp->seconds--;
+    stamp->nanoseconds += billion;
+  }
+}
+
+/* Converts a drift rate into the multiplier by which elapsed local
+   nanoseconds are scaled, with a shift of ERR_MULT_SHIFT, to get error
+   growth. Rounds up, so the result is conservative. */
+static inline uint64_t drift_ppb_to_err_mult(int64_t drift_ppb) {
+  __int128 mult;
+  if (drift_ppb <= 0) return 0;
+  mult = (((__int128)drift_ppb * 2 << ERR_MULT_SHIFT) + billion - 1) / billion;
+  return mult > UINT64_MAX ? UINT64_MAX : (uint64_t)mult;
+}
+
+/* Converts a CLOCK_MONOTONIC reading into an estimate of
+   CLOCK_MONOTONIC_RAW using the sample published in `aux`, and returns
+   the error of that estimate in `err_ns`. Since the kernel may have
+   changed the rate of CLOCK_MONOTONIC since the sample was taken, the
+   error grows with the time elapsed since then at the largest rate
+   difference its NTP discipline permits. Providers only publish a sample
+   while the tick length is nominal, so that this bound holds. */
+static inline void aux_mono_to_raw(timedata_aux const *aux, int64_t mono_ns,
+                                   int64_t *raw_ns, int64_t *err_ns) {
+  int64_t elapsed = mono_ns - aux->mono_ref;
+  int64_t abs_elapsed = elapsed < 0 ? -elapsed : elapsed;
+  int64_t abs_rate =
+      aux->mono_rate_ppb < 0 ? -aux->mono_rate_ppb : aux->mono_rate_ppb;
+
+  *raw_ns = aux->raw_ref + elapsed +
+            (int64_t)((__int128)elapsed * aux->mono_rate_ppb / billion);
+  *err_ns = aux->mono_err +
+            (int64_t)(((__int128)abs_elapsed * (max_mono_adj_ppb + abs_rate) +
+                       billion - 1) /
+                      billion);
+}
+
+/* Evaluates the provider-side slew correction described by `aux` at local
+   time `local_ns`. */
+static inline int64_t aux_slew_correction(timedata_aux const *aux,
+                                          int64_t local_ns) {
+  if (local_ns >= aux->slew_end) return 0;
+  return aux->slew_remaining +
+         (int64_t)((__int128)(local_ns - aux->slew_start) *
+                   aux->slew_rate_ppb / billion);
+}
 
 static inline void load_era(unsigned char out[BYZTIME_ERA_LEN], era const *in) {
   atomic_thread_fence(memory_order_acquire);
@@ -122,4 +356,112 @@ static inline void store_magic(magic *out,
 
 int byztime_init_sigbus_key();
 
+/* Returns a bound, in parts per billion, on how far the rate of
+   CLOCK_MONOTONIC and the other clocks disciplined by the kernel can
+   currently deviate from that of CLOCK_MONOTONIC_RAW: max_mono_adj_ppb
+   plus however far ADJ_TICK has moved the tick length from nominal, or
+   plus max_tick_adj_ppb if that can't be determined. */
+int64_t byztime_mono_adj_bound_ppb(void);
+
+/* Number of samples retained per clock by the cross-clock calibrator. */
+#define CAL_SAMPLES 16
+
+typedef struct cal_sample_s {
+  int64_t clock;
+  int64_t raw;
+  int64_t err;
+} cal_sample;
+
+/* A copy of the calibration history for one clock, oldest sample first.
+   `identity` is set for CLOCK_MONOTONIC_RAW itself. */
+typedef struct cal_snapshot_s {
+  bool identity;
+  int nsamples;
+  int64_t rate_ppb;
+  /* byztime_mono_adj_bound_ppb() at its largest over the samples. */
+  int64_t adj_ppb;
+  cal_sample samples[CAL_SAMPLES];
+} cal_snapshot;
+
+/* Takes a snapshot of the calibration history for `clock`, sampling it
+   first if the history is empty or stale. */
+int byztime_cal_snapshot(clockid_t clock, cal_snapshot *snap);
+
+/* Converts a reading `x` of a calibrated clock into bounds and an
+   estimate of the corresponding CLOCK_MONOTONIC_RAW reading. */
+void byztime_cal_convert(cal_snapshot const *snap, int64_t x, int64_t *lo,
+                         int64_t *est, int64_t *hi);
+
+/* Loads and validates the current entry and its auxiliary record, which
+   is zeroed if there is none. */
+int byztime_load_entry(byztime_ctx *ctx, timedata_entry *entry,
+                       timedata_aux *aux);
+
+/* Computes the global time corresponding to a local time which is known
+   to lie in [local_min, local_max] and estimated to be local_est (all in
+   nanoseconds), according to a previously loaded entry. The estimate is
+   unslewed unless `ctx` is following the provider's slew. */
+int byztime_entry_global_time(byztime_ctx const *ctx,
+                              timedata_entry const *entry,
+                              timedata_aux const *aux, int64_t local_min,
+                              int64_t local_est, int64_t local_max,
+                              byztime_interval *out);
+
+/* Reads the local clock and computes the current global time according
+   to a previously loaded entry, exactly as byztime_get_global_time_ns()
+   does. The local time that was read is returned in `local_ns`. */
+int byztime_entry_global_time_now_ns(byztime_ctx const *ctx,
+                                     timedata_entry const *entry,
+                                     timedata_aux const *aux,
+                                     int64_t *local_ns, int64_t *min,
+                                     int64_t *est, int64_t *max);
+
+/* The part of byztime_entry_global_time_now_ns() which evaluates the
+   linear model in `aux`, at local time `local_ns` read with error
+   `clock_error`. Its bounds must contain those that
+   byztime_entry_global_time() gives at the same local time, before or
+   after as_of. */
+int byztime_entry_global_time_linear_ns(byztime_ctx const *ctx,
+                                        timedata_aux const *aux,
+                                        int64_t local_ns, int64_t clock_error,
+                                        int64_t *min, int64_t *est,
+                                        int64_t *max);
+
+/* Fills in the linear model of `aux` from `entry`, as the provider does
+   when publishing. */
+void byztime_compute_linear_model(timedata_entry const *entry,
+                                  timedata_aux *aux);
+
+/* Sets the rates between which byztime_slew() clamps estimates, along
+   with the coefficients that byztime_slew_unclamped() needs. */
+void byztime_slew_set_rates(byztime_ctx *ctx, int64_t min_rate_ppb,
+                            int64_t max_rate_ppb);
+
+/* The two ways that a slewing read computes its estimate from an entry
+   with offset `offset`, given the previous read recorded in `ctx`. If
+   byztime_slew_unclamped() returns true, the estimate is just `offset`,
+   without further checks. Otherwise byztime_slew_clamp() computes it in
+   full. The first must never return true where the second would give a
+   different answer or fail. */
+bool byztime_slew_unclamped(byztime_ctx const *ctx,
+                            byztime_stamp const *local_time,
+                            byztime_stamp const *offset);
+int byztime_slew_clamp(byztime_ctx const *ctx, byztime_stamp const *local_time,
+                       byztime_stamp const *offset, byztime_stamp *est);
+
+/* A queued offset in a real-time publisher's ring. `as_of` is always
+   set, to the local time of the byztime_rt_enqueue() call if the caller
+   passed NULL. */
+typedef struct rt_slot_s {
+  byztime_stamp offset;
+  byztime_stamp error;
+  byztime_stamp as_of;
+  int64_t enqueued_ns;
+} rt_slot;
+
+/* Fills in `slot` as byztime_rt_enqueue() does. */
+int byztime_rt_fill_slot(rt_slot *slot, byztime_stamp const *offset,
+                         byztime_stamp const *error,
+                         byztime_stamp const *as_of);
+
 #endif
@@ -0,0 +1,242 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* One-way latency.
+
+   If a message is sent at a global time known to lie in [s.min, s.max]
+   and received at one in [r.min, r.max], then its latency lies in
+   [r.min - s.max, r.max - s.min], and since it can't be negative, the
+   lower end is clamped at zero.
+
+   Aggregates over many samples are kept separately for the lower
+   bounds, the estimates and the upper bounds. Each sample's true
+   latency lies between its bounds, and both means and order statistics
+   are monotonic in every sample, so the true mean and the true quantiles
+   lie between those of the lower bounds and those of the upper bounds.
+
+   Quantiles come from log-linear histograms: values below 2^LAT_SUB_BITS
+   nanoseconds get a bucket each, and each power of two above that is
+   split into 2^LAT_SUB_BITS equal buckets, bounding relative error by
+   2^-LAT_SUB_BITS. Lower bounds are reported at their bucket's low edge
+   and upper bounds at their bucket's high edge, so that quantization
+   only ever widens the reported interval. */
+
+#define LAT_SUB_BITS 5
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS ((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+enum { LAT_MIN, LAT_EST, LAT_MAX, LAT_NHIST };
+
+struct byztime_latency_stats_s {
+  uint64_t count;
+  __int128 sum[LAT_NHIST];
+  uint64_t hist[LAT_NHIST][LAT_BUCKETS];
+};
+
+static inline unsigned lat_bucket(uint64_t v) {
+  unsigned e;
+
+  if (v < LAT_SUB) return (unsigned)v;
+  e = 63 - (unsigned)__builtin_clzll(v);
+  return (e - LAT_SUB_BITS + 1) * LAT_SUB +
+         (unsigned)(v >> (e - LAT_SUB_BITS)) - LAT_SUB;
+}
+
+static inline uint64_t lat_bucket_low(unsigned b) {
+  unsigned e, m;
+
+  if (b < LAT_SUB) return b;
+  e = b / LAT_SUB + LAT_SUB_BITS - 1;
+  m = b % LAT_SUB + LAT_SUB;
+  return (uint64_t)m << (e - LAT_SUB_BITS);
+}
+
+static inline uint64_t lat_bucket_high(unsigned b) {
+  if (b + 1 == LAT_BUCKETS) return UINT64_MAX;
+  return lat_bucket_low(b + 1) - 1;
+}
+
+int byztime_latency(byztime_interval *latency, byztime_interval const *send,
+                    byztime_interval const *recv) {
+  byztime_interval l;
+
+  if (byztime_stamp_sub(&l.max, &recv->max, &send->min) < 0) return -1;
+  if (l.max.seconds < 0) {
+    errno = EDOM;
+    return -1;
+  }
+
+  /* If recv->min - send->max overflows it is hugely negative, because
+     l.max above is not. */
+  if (byztime_stamp_sub(&l.min, &recv->min, &send->max) < 0 ||
+      l.min.seconds < 0)
+    l.min = zerostamp;
+
+  if (byztime_stamp_sub(&l.est, &recv->est, &send->est) < 0 ||
+      byztime_stamp_cmp(&l.est, &l.min) < 0)
+    l.est = l.min;
+  else if (byztime_stamp_cmp(&l.est, &l.max) > 0)
+    l.est = l.max;
+
+  *latency = l;
+  return 0;
+}
+
+int byztime_latency_batch(byztime_interval latency[],
+                          byztime_interval const send[],
+                          byztime_interval const recv[], size_t n) {
+  int first_errno = 0;
+
+  for (size_t k = 0; k < n; k++) {
+    if (byztime_latency(&latency[k], &send[k], &recv[k]) < 0) {
+      if (first_errno == 0) first_errno = errno;
+      memset(&latency[k], 0, sizeof latency[k]);
+    }
+  }
+
+  if (first_errno != 0) {
+    errno = first_errno;
+    return -1;
+  }
+  return 0;
+}
+
+byztime_latency_stats *byztime_latency_stats_new(void) {
+  byztime_latency_stats *stats = malloc(sizeof(byztime_latency_stats));
+  if (stats == NULL) return NULL;
+  byztime_latency_stats_reset(stats);
+  return stats;
+}
+
+void byztime_latency_stats_free(byztime_latency_stats *stats) { free(stats); }
+
+void byztime_latency_stats_reset(byztime_latency_stats *stats) {
+  memset(stats, 0, sizeof *stats);
+}
+
+int byztime_latency_stats_add(byztime_latency_stats *stats,
+                              byztime_interval const *latency) {
+  int64_t ns[LAT_NHIST];
+
+  if (stamp_to_ns(&ns[LAT_MIN], &latency->min) < 0 ||
+      stamp_to_ns(&ns[LAT_EST], &latency->est) < 0 ||
+      stamp_to_ns(&ns[LAT_MAX], &latency->max) < 0)
+    return -1;
+
+  if (ns[LAT_MIN] < 0 || ns[LAT_EST] < ns[LAT_MIN] ||
+      ns[LAT_MAX] < ns[LAT_EST]) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  stats->count++;
+  for (int h = 0; h < LAT_NHIST; h++) {
+    stats->sum[h] += ns[h];
+    stats->hist[h][lat_bucket((uint64_t)ns[h])]++;
+  }
+  return 0;
+}
+
+int byztime_latency_stats_add_batch(byztime_latency_stats *stats,
+                                    byztime_interval const latency[],
+                                    size_t n) {
+  for (size_t k = 0; k < n; k++) {
+    if (byztime_latency_stats_add(stats, &latency[k]) < 0) return -1;
+  }
+  return 0;
+}
+
+void byztime_latency_stats_merge(byztime_latency_stats *dst,
+                                 byztime_latency_stats const *src) {
+  dst->count += src->count;
+  for (int h = 0; h < LAT_NHIST; h++) {
+    dst->sum[h] += src->sum[h];
+    for (unsigned b = 0; b < LAT_BUCKETS; b++)
+      dst->hist[h][b] += src->hist[h][b];
+  }
+}
+
+uint64_t byztime_latency_stats_count(byztime_latency_stats const *stats) {
+  return stats->count;
+}
+
+/* Divides a non-negative sum by a count, rounding down or up. The
+   quotient is at most the largest sample, so it fits in 64 bits. */
+static int64_t lat_div(__int128 sum, uint64_t count, bool round_up) {
+  __int128 q = sum / count;
+  if (round_up && q * count != sum) q++;
+  return (int64_t)q;
+}
+
+int byztime_latency_stats_mean(byztime_latency_stats const *stats,
+                               byztime_interval *mean) {
+  if (stats->count == 0) {
+    errno = ENODATA;
+    return -1;
+  }
+
+  ns_to_stamp(&mean->min, lat_div(stats->sum[LAT_MIN], stats->count, false));
+  ns_to_stamp(&mean->est, lat_div(stats->sum[LAT_EST], stats->count, false));
+  ns_to_stamp(&mean->max, lat_div(stats->sum[LAT_MAX], stats->count, true));
+  return 0;
+}
+
+/* Finds the bucket holding the sample of the given rank, counting from
+   1. */
+static unsigned lat_rank_bucket(uint64_t const hist[LAT_BUCKETS],
+                                uint64_t rank) {
+  uint64_t seen = 0;
+
+  for (unsigned b = 0; b < LAT_BUCKETS; b++) {
+    seen += hist[b];
+    if (seen >= rank) return b;
+  }
+  return LAT_BUCKETS - 1;
+}
+
+static int64_t lat_clamp(uint64_t v) {
+  return v > INT64_MAX ? INT64_MAX : (int64_t)v;
+}
+
+int byztime_latency_stats_quantile(byztime_latency_stats const *stats,
+                                   double q, byztime_interval *quantile) {
+  uint64_t rank;
+  unsigned b;
+  int64_t min, est, max;
+
+  if (!(q >= 0.0 && q <= 1.0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (stats->count == 0) {
+    errno = ENODATA;
+    return -1;
+  }
+
+  rank = (uint64_t)(q * (double)stats->count);
+  if ((double)rank < q * (double)stats->count) rank++;
+  if (rank == 0) rank = 1;
+  if (rank > stats->count) rank = stats->count;
+
+  min = lat_clamp(lat_bucket_low(lat_rank_bucket(stats->hist[LAT_MIN], rank)));
+  max =
+      lat_clamp(lat_bucket_high(lat_rank_bucket(stats->hist[LAT_MAX], rank)));
+  b = lat_rank_bucket(stats->hist[LAT_EST], rank);
+  est = lat_clamp(lat_bucket_low(b) +
+                  (lat_bucket_high(b) - lat_bucket_low(b)) / 2);
+  if (est < min) est = min;
+  if (est > max) est = max;
+
+  ns_to_stamp(&quantile->min, min);
+  ns_to_stamp(&quantile->est, est);
+  ns_to_stamp(&quantile->max, max);
+  return 0;
+}
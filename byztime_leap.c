@@ -0,0 +1,350 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Leap seconds.
+
+   The table is a sorted array of segments, each the span of POSIX time
+   over which TAI - UTC is constant. A segment begins at `utc_start`, the
+   POSIX time of the first second after a leap, or equivalently at TAI
+   `tai_start = utc_start + offset`. Lookups by either key start from
+   the segment the previous lookup found, which for a stream of nearby
+   times is nearly always right, and fall back to binary search.
+
+   POSIX time has no name for an inserted leap second, so TAI within one
+   maps to the POSIX second after it, which therefore occurs twice.
+
+   Smeared UTC instead absorbs each leap second by running slow (or
+   fast) for a window of `smear` nanoseconds of smeared time centred on
+   the leap, during which it advances linearly relative to TAI. With the
+   usual 24-hour window this runs from noon to noon UTC. Outside of any
+   window, smeared time agrees with UTC.
+
+   All arithmetic is in 64-bit nanoseconds, which covers the years 1678
+   to 2262. */
+
+/* Seconds from the NTP epoch (1900) to the POSIX epoch (1970). */
+#define NTP_TO_POSIX 2208988800LL
+
+/* Bound on the smear window, which must not be allowed to reach from
+   one leap second to the next. */
+#define MAX_SMEAR_NS (30LL * 86400 * billion)
+
+typedef struct leap_segment_s {
+  int64_t utc_start;
+  int64_t tai_start;
+  int64_t offset;
+} leap_segment;
+
+struct byztime_leap_table_s {
+  leap_segment *segs;
+  size_t nsegs;
+  int64_t smear;
+  int64_t expires;
+  atomic_size_t hint;
+};
+
+/* Returns the index of the last segment whose `key` start is at most x,
+   or 0 if there is none. */
+#define DEFINE_LOOKUP(key)                                                   \
+  static size_t lookup_##key(byztime_leap_table const *table, int64_t x) {   \
+    byztime_leap_table *t = (byztime_leap_table *)table;                     \
+    leap_segment const *segs = table->segs;                                  \
+    size_t n = table->nsegs;                                                 \
+    size_t k = atomic_load_explicit(&t->hint, memory_order_relaxed);         \
+    size_t left, right;                                                      \
+                                                                             \
+    if (segs[k].key <= x && (k + 1 == n || x < segs[k + 1].key)) return k;   \
+                                                                             \
+    left = 1;                                                                \
+    right = n;                                                               \
+    while (left < right) {                                                   \
+      size_t mid = left + (right - left) / 2;                                \
+      if (segs[mid].key <= x)                                                \
+        left = mid + 1;                                                      \
+      else                                                                   \
+        right = mid;                                                         \
+    }                                                                        \
+    k = left - 1;                                                            \
+    atomic_store_explicit(&t->hint, k, memory_order_relaxed);                \
+    return k;                                                                \
+  }
+
+DEFINE_LOOKUP(utc_start)
+DEFINE_LOOKUP(tai_start)
+
+/* Smeared time at TAI t, within the window of the leap that begins
+   segment j. */
+static int64_t smear_from_tai(byztime_leap_table const *table, size_t j,
+                              int64_t t) {
+  int64_t w = table->smear;
+  int64_t d = table->segs[j].offset - table->segs[j - 1].offset;
+  int64_t a = table->segs[j].utc_start - w / 2 + table->segs[j - 1].offset;
+  __int128 shift = (__int128)d * (t - a) / (w + d);
+  return t - table->segs[j - 1].offset - (int64_t)shift;
+}
+
+/* TAI at smeared time s, within the window of the leap that begins
+   segment j. */
+static int64_t tai_from_smear(byztime_leap_table const *table, size_t j,
+                              int64_t s) {
+  int64_t w = table->smear;
+  int64_t d = table->segs[j].offset - table->segs[j - 1].offset;
+  int64_t a = table->segs[j].utc_start - w / 2 + table->segs[j - 1].offset;
+  int64_t u = s - (table->segs[j].utc_start - w / 2);
+  return a + (int64_t)((__int128)u * (w + d) / w);
+}
+
+static int to_tai(byztime_leap_table const *table, int64_t *tai, int scale,
+                  int64_t x) {
+  size_t k;
+
+  switch (scale) {
+    case BYZTIME_TIMESCALE_TAI:
+      *tai = x;
+      return 0;
+    case BYZTIME_TIMESCALE_UTC:
+      k = lookup_utc_start(table, x);
+      break;
+    case BYZTIME_TIMESCALE_SMEARED:
+      k = lookup_utc_start(table, x);
+      if (k + 1 < table->nsegs &&
+          x >= table->segs[k + 1].utc_start - table->smear / 2) {
+        *tai = tai_from_smear(table, k + 1, x);
+        return 0;
+      }
+      if (k > 0 && x < table->segs[k].utc_start + table->smear / 2) {
+        *tai = tai_from_smear(table, k, x);
+        return 0;
+      }
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+
+  if (__builtin_add_overflow(x, table->segs[k].offset, tai)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  return 0;
+}
+
+static int from_tai(byztime_leap_table const *table, int64_t *out, int scale,
+                    int64_t tai) {
+  size_t k;
+
+  switch (scale) {
+    case BYZTIME_TIMESCALE_TAI:
+      *out = tai;
+      return 0;
+    case BYZTIME_TIMESCALE_UTC:
+      k = lookup_tai_start(table, tai);
+      break;
+    case BYZTIME_TIMESCALE_SMEARED: {
+      int64_t w = table->smear;
+      k = lookup_tai_start(table, tai);
+      if (k + 1 < table->nsegs &&
+          tai >= table->segs[k + 1].utc_start - w / 2 + table->segs[k].offset) {
+        *out = smear_from_tai(table, k + 1, tai);
+        return 0;
+      }
+      if (k > 0 &&
+          tai < table->segs[k].utc_start + w / 2 + table->segs[k].offset) {
+        *out = smear_from_tai(table, k, tai);
+        return 0;
+      }
+      break;
+    }
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+
+  if (__builtin_sub_overflow(tai, table->segs[k].offset, out)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  return 0;
+}
+
+int byztime_leap_convert(byztime_leap_table const *table, int to_scale,
+                         byztime_stamp *out, int from_scale,
+                         byztime_stamp const *in,
+                         byztime_stamp const *real_offset) {
+  byztime_stamp utc;
+  int64_t x, tai, y;
+
+  if (from_scale == BYZTIME_TIMESCALE_GLOBAL ||
+      to_scale == BYZTIME_TIMESCALE_GLOBAL) {
+    if (real_offset == NULL) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  if (from_scale == BYZTIME_TIMESCALE_GLOBAL) {
+    if (byztime_stamp_sub(&utc, in, real_offset) < 0) return -1;
+    in = &utc;
+    from_scale = BYZTIME_TIMESCALE_UTC;
+  }
+
+  if (to_scale == BYZTIME_TIMESCALE_GLOBAL) {
+    if (byztime_leap_convert(table, BYZTIME_TIMESCALE_UTC, &utc, from_scale,
+                             in, NULL) < 0)
+      return -1;
+    return byztime_stamp_add(out, &utc, real_offset);
+  }
+
+  if (stamp_to_ns(&x, in) < 0) return -1;
+  if (to_tai(table, &tai, from_scale, x) < 0) return -1;
+  if (from_tai(table, &y, to_scale, tai) < 0) return -1;
+  ns_to_stamp(out, y);
+  return 0;
+}
+
+int byztime_leap_convert_batch(byztime_leap_table const *table, int to_scale,
+                               byztime_stamp out[], int from_scale,
+                               byztime_stamp const in[], size_t n,
+                               byztime_stamp const *real_offset) {
+  for (size_t k = 0; k < n; k++) {
+    if (byztime_leap_convert(table, to_scale, &out[k], from_scale, &in[k],
+                             real_offset) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+void byztime_leap_expires(byztime_leap_table const *table,
+                          byztime_stamp *expires) {
+  ns_to_stamp(expires, table->expires);
+}
+
+/* Parses a decimal integer followed by whitespace or the end of the
+   string. */
+static int parse_int(char const **p, int64_t *out) {
+  char *end;
+  long long v;
+
+  errno = 0;
+  v = strtoll(*p, &end, 10);
+  if (errno != 0 || end == *p ||
+      (*end != '\0' && *end != ' ' && *end != '\t' && *end != '\n' &&
+       *end != '#'))
+    return -1;
+  *out = v;
+  *p = end;
+  return 0;
+}
+
+static int ntp_to_ns(int64_t ntp, int64_t *ns) {
+  return __builtin_sub_overflow(ntp, NTP_TO_POSIX, &ntp) ||
+         __builtin_mul_overflow(ntp, (int64_t)billion, ns);
+}
+
+byztime_leap_table *byztime_leap_load(char const *path, int64_t smear) {
+  byztime_leap_table *table;
+  FILE *file;
+  char *line = NULL;
+  size_t line_cap = 0, cap = 0;
+  bool have_expiry = false;
+  int saved_errno;
+
+  if (smear <= 2 * (int64_t)billion || smear > MAX_SMEAR_NS) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  table = malloc(sizeof(byztime_leap_table));
+  if (table == NULL) return NULL;
+  memset(table, 0, sizeof *table);
+  table->smear = smear;
+  atomic_init(&table->hint, 0);
+
+  file = fopen(path, "re");
+  if (file == NULL) goto fail;
+
+  while (getline(&line, &line_cap, file) >= 0) {
+    char const *p = line;
+    int64_t ntp, dtai;
+    leap_segment *seg;
+
+    if (p[0] == '#') {
+      if (p[1] == '@') {
+        p += 2;
+        while (*p == ' ' || *p == '\t') p++;
+        if (parse_int(&p, &ntp) < 0 || ntp_to_ns(ntp, &table->expires))
+          goto fail_proto;
+        have_expiry = true;
+      }
+      continue;
+    }
+
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '\n' || *p == '\0') continue;
+
+    if (parse_int(&p, &ntp) < 0) goto fail_proto;
+    while (*p == ' ' || *p == '\t') p++;
+    if (parse_int(&p, &dtai) < 0) goto fail_proto;
+
+    if (table->nsegs == cap) {
+      size_t new_cap = cap ? 2 * cap : 32;
+      leap_segment *segs = realloc(table->segs, new_cap * sizeof *segs);
+      if (segs == NULL) goto fail_close;
+      table->segs = segs;
+      cap = new_cap;
+    }
+
+    seg = &table->segs[table->nsegs];
+    if (ntp_to_ns(ntp, &seg->utc_start) ||
+        __builtin_mul_overflow(dtai, (int64_t)billion, &seg->offset) ||
+        __builtin_add_overflow(seg->utc_start, seg->offset, &seg->tai_start))
+      goto fail_proto;
+
+    /* Entries must be in order, each a single leap second, and far
+       enough apart for their smear windows not to overlap. */
+    if (table->nsegs > 0) {
+      leap_segment const *prev = seg - 1;
+      int64_t d = seg->offset - prev->offset;
+      if ((d != billion && d != -(int64_t)billion) ||
+          seg->utc_start - prev->utc_start <= smear + 2 * (int64_t)billion)
+        goto fail_proto;
+    }
+    table->nsegs++;
+  }
+
+  if (ferror(file)) goto fail_close;
+  if (table->nsegs == 0 || !have_expiry) goto fail_proto;
+
+  free(line);
+  fclose(file);
+  return table;
+
+fail_proto:
+  errno = EPROTO;
+fail_close:
+  saved_errno = errno;
+  free(line);
+  fclose(file);
+  errno = saved_errno;
+fail:
+  saved_errno = errno;
+  free(table->segs);
+  free(table);
+  errno = saved_errno;
+  return NULL;
+}
+
+void byztime_leap_free(byztime_leap_table *table) {
+  if (table == NULL) return;
+  free(table->segs);
+  free(table);
+}
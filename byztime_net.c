@@ -0,0 +1,94 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _GNU_SOURCE
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <linux/net_tstamp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+/* The payload of an SCM_TIMESTAMPING control message. The kernel
+   defines this as struct scm_timestamping in <linux/errqueue.h>, but
+   that header doesn't coexist well with libc's. Software timestamps are
+   in ts[0]. */
+typedef struct scm_timestamping_payload_s {
+  struct timespec ts[3];
+} scm_timestamping_payload;
+
+int byztime_enable_rx_timestamps(int sockfd) {
+  int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  return setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof flags);
+}
+
+/* Finds the kernel's software receive timestamp among a message's
+   control messages. Returns false if there is none. */
+static bool find_rx_timestamp(struct msghdr *msg, int64_t *ns) {
+  struct cmsghdr *cmsg;
+
+  for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+    struct timespec ts;
+
+    if (cmsg->cmsg_level != SOL_SOCKET) continue;
+
+    if (cmsg->cmsg_type == SCM_TIMESTAMPING &&
+        cmsg->cmsg_len >= CMSG_LEN(sizeof(scm_timestamping_payload))) {
+      scm_timestamping_payload payload;
+      memcpy(&payload, CMSG_DATA(cmsg), sizeof payload);
+      ts = payload.ts[0];
+    } else if (cmsg->cmsg_type == SCM_TIMESTAMPNS &&
+               cmsg->cmsg_len >= CMSG_LEN(sizeof(struct timespec))) {
+      memcpy(&ts, CMSG_DATA(cmsg), sizeof ts);
+    } else {
+      continue;
+    }
+
+    if (ts.tv_sec == 0 && ts.tv_nsec == 0) continue;
+    *ns = (int64_t)ts.tv_sec * billion + ts.tv_nsec;
+    return true;
+  }
+
+  return false;
+}
+
+int byztime_recvmmsg(byztime_ctx *ctx, int sockfd, struct mmsghdr *msgvec,
+                     unsigned int vlen, int flags, struct timespec *timeout,
+                     byztime_interval stamps[]) {
+  cal_snapshot snap;
+  timedata_entry entry;
+  timedata_aux aux;
+  bool can_convert;
+  int received, saved_errno;
+
+  received = recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+  if (received <= 0) return received;
+
+  /* Kernel software timestamps are taken from CLOCK_REALTIME. Every
+     message in the batch is converted using the same calibration and
+     the same entry. The datagrams have been consumed by now, so a
+     failure here mustn't lose them: it just leaves them unstamped. */
+  saved_errno = errno;
+  can_convert = byztime_cal_snapshot(CLOCK_REALTIME, &snap) == 0 &&
+                byztime_load_entry(ctx, &entry, &aux) == 0;
+  errno = saved_errno;
+
+  for (int k = 0; k < received; k++) {
+    int64_t x, lo, est, hi;
+
+    if (!can_convert || !find_rx_timestamp(&msgvec[k].msg_hdr, &x)) {
+      memset(&stamps[k], 0, sizeof stamps[k]);
+      continue;
+    }
+
+    byztime_cal_convert(&snap, x, &lo, &est, &hi);
+    if (byztime_entry_global_time(ctx, &entry, &aux, lo, est, hi,
+                                  &stamps[k]) < 0) {
+      memset(&stamps[k], 0, sizeof stamps[k]);
+      errno = saved_errno;
+    }
+  }
+
+  return received;
+}
@@ -0,0 +1,164 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _GNU_SOURCE
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Per-CPU entry caches.
+
+   Every read of the timedata page touches the cache lines holding `i`
+   and the current entry, and every publish invalidates them in every
+   core's cache. For readers that hit the clock millions of times a
+   second we keep a private copy of the entry for each CPU, and readers
+   compute from the copy belonging to whichever CPU they find themselves
+   on. A copy is refreshed from the page once it is older than the
+   configured interval. Computing from an entry which has since been
+   superseded is still correct, only less tight: its error bound has
+   been growing at the drift rate since it was published, just as the
+   current one has.
+
+   Several threads can land on the same CPU, and a thread can migrate in
+   the middle of a read, so each slot is guarded by a seqlock. A reader
+   that finds its slot being written, or loses a race to refresh it,
+   just reads the page directly. */
+
+typedef struct percpu_slot_s {
+  _Alignas(64) atomic_uint_fast64_t seq;
+  bool valid;
+  /* Local time at which the copy was taken. */
+  int64_t fetched_ns;
+  timedata_entry entry;
+  timedata_aux aux;
+} percpu_slot;
+
+struct byztime_percpu_s {
+  byztime_ctx *ctx;
+  int64_t refresh_ns;
+  long nslots;
+  percpu_slot *slots;
+};
+
+byztime_percpu *byztime_percpu_new(byztime_ctx *ctx,
+                                   byztime_stamp const *refresh) {
+  byztime_percpu *pc;
+  int64_t refresh_ns;
+  long nslots;
+  void *mem;
+  int ret;
+
+  if (stamp_to_ns(&refresh_ns, refresh) < 0) return NULL;
+  if (refresh_ns <= 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  nslots = sysconf(_SC_NPROCESSORS_CONF);
+  if (nslots < 1) nslots = 1;
+
+  pc = malloc(sizeof(byztime_percpu));
+  if (pc == NULL) return NULL;
+
+  ret = posix_memalign(&mem, 64, nslots * sizeof(percpu_slot));
+  if (ret != 0) {
+    free(pc);
+    errno = ret;
+    return NULL;
+  }
+  memset(mem, 0, nslots * sizeof(percpu_slot));
+
+  pc->ctx = ctx;
+  pc->refresh_ns = refresh_ns;
+  pc->nslots = nslots;
+  pc->slots = mem;
+  for (long k = 0; k < nslots; k++) atomic_init(&pc->slots[k].seq, 0);
+
+  return pc;
+}
+
+void byztime_percpu_free(byztime_percpu *pc) {
+  if (pc == NULL) return;
+  free(pc->slots);
+  free(pc);
+}
+
+/* Copies a slot's contents if it is valid and not being written. */
+static bool slot_read(percpu_slot *slot, int64_t *fetched_ns,
+                      timedata_entry *entry, timedata_aux *aux) {
+  uint_fast64_t seq1, seq2;
+  bool valid;
+
+  seq1 = atomic_load_explicit(&slot->seq, memory_order_acquire);
+  if (seq1 & 1) return false;
+
+  valid = slot->valid;
+  *fetched_ns = slot->fetched_ns;
+  memcpy(entry, &slot->entry, sizeof(timedata_entry));
+  memcpy(aux, &slot->aux, sizeof(timedata_aux));
+
+  atomic_thread_fence(memory_order_acquire);
+  seq2 = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+  return valid && seq1 == seq2;
+}
+
+/* Installs a fresh copy in a slot unless someone else is already
+   writing it. */
+static void slot_write(percpu_slot *slot, int64_t fetched_ns,
+                       timedata_entry const *entry,
+                       timedata_aux const *aux) {
+  uint_fast64_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+  if ((seq & 1) ||
+      !atomic_compare_exchange_strong_explicit(
+          &slot->seq, &seq, seq + 1, memory_order_acquire,
+          memory_order_relaxed)) {
+    return;
+  }
+  atomic_thread_fence(memory_order_release);
+
+  slot->valid = true;
+  slot->fetched_ns = fetched_ns;
+  memcpy(&slot->entry, entry, sizeof(timedata_entry));
+  memcpy(&slot->aux, aux, sizeof(timedata_aux));
+
+  atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+}
+
+int byztime_percpu_get_global_time_ns(byztime_percpu *pc, int64_t *min,
+                                      int64_t *est, int64_t *max) {
+  timedata_entry entry;
+  timedata_aux aux;
+  percpu_slot *slot = NULL;
+  int64_t fetched_ns, local_ns, my_min, my_est, my_max;
+  int cpu = sched_getcpu();
+
+  if (cpu >= 0 && cpu < pc->nslots) slot = &pc->slots[cpu];
+
+  if (slot != NULL && slot_read(slot, &fetched_ns, &entry, &aux)) {
+    if (byztime_entry_global_time_now_ns(pc->ctx, &entry, &aux, &local_ns,
+                                         &my_min, &my_est, &my_max) < 0) {
+      return -1;
+    }
+    if (local_ns - fetched_ns < pc->refresh_ns) goto done;
+  }
+
+  if (byztime_load_entry(pc->ctx, &entry, &aux) < 0 ||
+      byztime_entry_global_time_now_ns(pc->ctx, &entry, &aux, &local_ns,
+                                       &my_min, &my_est, &my_max) < 0) {
+    return -1;
+  }
+  if (slot != NULL) slot_write(slot, local_ns, &entry, &aux);
+
+done:
+  if (min != NULL) *min = my_min;
+  if (est != NULL) *est = my_est;
+  if (max != NULL) *max = my_max;
+  return 0;
+}
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #define _POSIX_C_SOURCE 200112L
+#define _DEFAULT_SOURCE
 #include "byztime_internal.h"
 
 #include <assert.h>
@@ -15,6 +16,7 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 /* The lock-free algorithm that we use to access timedata means that
@@ -48,9 +50,8 @@
    holding the mutex.
 */
 
-static int acquire_lock(char const *pathname) {
+static int open_lock_file(char const *pathname) {
   char lock_pathname[PATH_MAX];
-  int lock_fd;
   if (realpath(pathname, lock_pathname) == NULL) { return -1; }
 
   if (strlen(lock_pathname) + strlen(".lock") + 1 > PATH_MAX) {
@@ -60,14 +61,68 @@ static int acquire_lock(char const *pathname) {
 
   strcat(lock_pathname, ".lock");
 
-  lock_fd = open(lock_pathname, O_RDWR | O_CREAT, 0600);
+  return open(lock_pathname, O_RDWR | O_CREAT, 0600);
+}
+
+static int acquire_lock(char const *pathname) {
+  int lock_fd, saved_errno;
+
+  lock_fd = open_lock_file(pathname);
   if (lock_fd < 0) { return -1; }
 
-  if (flock(lock_fd, LOCK_EX | LOCK_NB) < 0) { return -1; }
+  if (flock(lock_fd, LOCK_EX | LOCK_NB) < 0) {
+    saved_errno = errno;
+    close(lock_fd);
+    errno = saved_errno;
+    return -1;
+  }
 
   return lock_fd;
 }
 
+static void init_provider_state(byztime_ctx *ctx) {
+  ctx->drift_ppb = default_drift_ppb;
+  ctx->drift_err_mult = drift_ppb_to_err_mult(default_drift_ppb);
+  ctx->slew_mode = false;
+  ctx->is_default = false;
+  ctx->shared_slew = false;
+  ctx->measured_drift = false;
+  ctx->provider_slew = false;
+  ctx->drift_estimation = false;
+  ctx->local_clock = BYZTIME_LOCAL_CLOCK_RAW;
+  ctx->mono_have_prev = false;
+  ctx->mono_rate_ppb = 0;
+  ctx->coalesce = false;
+  ctx->tick_running = false;
+  ctx->standby = false;
+}
+
+/* Must only be called while holding the file lock. */
+static int init_mutex(byztime_ctx *ctx) {
+  pthread_mutexattr_t mutex_attr;
+  int ret;
+
+  ret = pthread_mutexattr_init(&mutex_attr);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+
+  ret = pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+
+  ret = pthread_mutex_init(&ctx->timedata->mutex, &mutex_attr);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+
+  return 0;
+}
+
 /* Invariants to be maintained while the timedata file is being
    updated or initalized:
 
@@ -100,13 +155,29 @@ byztime_ctx *byztime_open_rw(char const *pathname) {
   ctx->lock_fd = acquire_lock(pathname);
   if (ctx->lock_fd < 0) goto fail_close;
 
-  if ((errno = posix_fallocate(ctx->fd, 0, sizeof(timedata))) < 0) {
+  ctx->map_len = sizeof(timedata) + sizeof(timedata_ext);
+
+  if ((errno = posix_fallocate(ctx->fd, 0, ctx->map_len)) != 0) {
     goto fail_release_lock;
   }
 
-  ctx->timedata = mmap(NULL, sizeof(timedata), PROT_READ | PROT_WRITE,
+  ctx->timedata = mmap(NULL, ctx->map_len, PROT_READ | PROT_WRITE,
                        MAP_SHARED, ctx->fd, 0);
   if (ctx->timedata == MAP_FAILED) goto fail_release_lock;
+  ctx->ext = (timedata_ext *)(ctx->timedata + 1);
+
+  /* The extension region is independent of the first page: a file
+     written by an older provider has none, and one with a valid
+     extension may have had its first page re-initialized since. So
+     it gets its own magic, set after zeroing the rest of it. */
+  load_magic(stored_magic, &ctx->ext->magic);
+  if (memcmp(stored_magic, expected_ext_magic, sizeof expected_ext_magic)) {
+    memset(ctx->ext, 0, sizeof(timedata_ext));
+    store_magic(&ctx->ext->magic, expected_ext_magic);
+  }
+
+  /* Any tick still there belongs to a previous provider. */
+  atomic_store_explicit(&ctx->ext->tick.seq, 0, memory_order_release);
 
   load_magic(stored_magic, &ctx->timedata->magic);
   if (memcmp(stored_magic, expected_magic, sizeof expected_magic) ||
@@ -116,6 +187,7 @@ byztime_ctx *byztime_open_rw(char const *pathname) {
     timedata_entry entry;
     byztime_stamp local_time, real_time;
 
+    memset(&entry, 0, sizeof entry);
     ctx->timedata->real_offset.seconds = 0;
     ctx->timedata->real_offset.nanoseconds = 0;
 
@@ -138,6 +210,8 @@ byztime_ctx *byztime_open_rw(char const *pathname) {
       timedata_entry entry;
       byztime_stamp local_time, real_time, global_time;
 
+      memset(&entry, 0, sizeof entry);
+
       if (byztime_get_local_time(&local_time) < 0 ||
           byztime_get_real_time(&real_time) < 0 ||
           byztime_stamp_add(&global_time, &real_time,
@@ -155,37 +229,519 @@ byztime_ctx *byztime_open_rw(char const *pathname) {
     }
   }
 
-  ctx->drift_ppb = default_drift_ppb;
-  ctx->slew_mode = false;
+  init_provider_state(ctx);
+  if (init_mutex(ctx) < 0) goto fail_unmap;
 
-  pthread_mutexattr_t mutex_attr;
+  return ctx;
 
-  ret = pthread_mutexattr_init(&mutex_attr);
+fail_unmap:
+  saved_errno = errno;
+  ret = munmap(ctx->timedata, ctx->map_len);
+  assert(ret == 0);
+  errno = saved_errno;
+fail_release_lock:
+  saved_errno = errno;
+  close(ctx->lock_fd);
+  errno = saved_errno;
+fail_close:
+  saved_errno = errno;
+  close(ctx->fd);
+  errno = saved_errno;
+fail_free_ctx:
+  free(ctx);
+  return NULL;
+}
+
+/* Computes the provider-side slew segment which begins at local time
+   `now_ns` and carries the previously-published estimate toward
+   `entry->offset`. Must be called with the mutex held. */
+static void compute_slew(byztime_ctx *ctx, timedata_entry const *entry,
+                         timedata_aux *aux, int64_t now_ns) {
+  int i = atomic_load_explicit(&ctx->timedata->i, memory_order_relaxed);
+  timedata_entry const *prev = &ctx->timedata->entries[i];
+  timedata_aux const *prev_aux = &ctx->ext->aux[i];
+  int64_t prev_offset_ns, offset_ns, remaining;
+  __int128 magnitude, rate, duration;
+
+  if (stamp_to_ns(&prev_offset_ns, &prev->offset) < 0 ||
+      stamp_to_ns(&offset_ns, &entry->offset) < 0) {
+    return;
+  }
+
+  if (prev->seq != 0 && prev_aux->seq == prev->seq) {
+    prev_offset_ns += aux_slew_correction(prev_aux, now_ns);
+  }
+
+  if (__builtin_sub_overflow(prev_offset_ns, offset_ns, &remaining) ||
+      remaining == 0) {
+    return;
+  }
+
+  if (remaining > 0) {
+    aux->slew_rate_ppb = ctx->provider_min_rate_ppb - billion;
+  } else if (ctx->provider_max_rate_ppb < INT64_MAX) {
+    aux->slew_rate_ppb = ctx->provider_max_rate_ppb - billion;
+  } else {
+    return;
+  }
+
+  if (aux->slew_rate_ppb == 0) return;
+
+  /* The rate always has the opposite sign to the remaining correction.
+     Round the duration up so that the correction has fully decayed by
+     slew_end. */
+  magnitude = remaining > 0 ? remaining : -(__int128)remaining;
+  rate = aux->slew_rate_ppb > 0 ? aux->slew_rate_ppb
+                                : -(__int128)aux->slew_rate_ppb;
+  duration = (magnitude * billion + rate - 1) / rate;
+
+  aux->slew_start = now_ns;
+  aux->slew_remaining = remaining;
+  aux->slew_end = duration > INT64_MAX - now_ns ? INT64_MAX
+                                                 : now_ns + (int64_t)duration;
+}
+
+/* Records a measurement in the drift estimator's history and returns the
+   drift bound to publish with it, or zero if there isn't one yet.
+
+   Two measurements (o1 +/- e1 at local time t1) and (o2 +/- e2 at t2)
+   imply that the offset changed by at most |o2 - o1| + e1 + e2 over
+   t2 - t1, which bounds the average drift over that interval. We keep
+   a history of measurements spaced across the configured window and
+   use the loosest bound given by any pair spanning at least a quarter
+   of it, so that the error terms are amortized over a long enough
+   interval to be meaningful. A tighter pair only bounds the average
+   over its own interval, and the drift may have been faster in some
+   other part of the window, so the minimum would not be safe to
+   publish. Consumers double whatever we publish when computing error
+   growth, which gives further headroom for the drift rate varying over
+   time.
+
+   Must be called with the mutex held, like everything else in publish()
+   that touches provider state. */
+static int64_t estimate_drift(byztime_ctx *ctx, byztime_stamp const *offset,
+                              byztime_stamp const *error,
+                              byztime_stamp const *as_of) {
+  drift_sample sample;
+  __int128 best = -1;
+
+  if (stamp_to_ns(&sample.as_of, as_of) < 0 ||
+      stamp_to_ns(&sample.offset, offset) < 0 ||
+      stamp_to_ns(&sample.error, error) < 0) {
+    return 0;
+  }
+
+  for (int k = 0; k < ctx->drift_nsamples; k++) {
+    drift_sample const *old = &ctx->drift_samples[k];
+    __int128 interval = (__int128)sample.as_of - old->as_of;
+    __int128 change = (__int128)sample.offset - old->offset;
+    __int128 bound;
+
+    if (interval < ctx->drift_window / 4) continue;
+    if (change < 0) change = -change;
+    change += (__int128)sample.error + old->error;
+    bound = (change * billion + interval - 1) / interval;
+    if (bound > best) best = bound;
+  }
+
+  /* Store the sample unless it is too close to the newest one already
+     stored, so that the history spans the whole window. */
+  if (ctx->drift_nsamples == 0 ||
+      (__int128)sample.as_of -
+              ctx->drift_samples[(ctx->drift_head + DRIFT_SAMPLES - 1) %
+                                 DRIFT_SAMPLES]
+                  .as_of >=
+          ctx->drift_window / DRIFT_SAMPLES) {
+    ctx->drift_samples[ctx->drift_head] = sample;
+    ctx->drift_head = (ctx->drift_head + 1) % DRIFT_SAMPLES;
+    if (ctx->drift_nsamples < DRIFT_SAMPLES) ctx->drift_nsamples++;
+  }
+
+  if (best < 0) return 0;
+  if (best > INT64_MAX) return INT64_MAX;
+  if (best < min_measured_drift_ppb) return min_measured_drift_ppb;
+  return (int64_t)best;
+}
+
+/* Samples CLOCK_MONOTONIC against CLOCK_MONOTONIC_RAW for consumers
+   which read the former, and updates our measurement of their relative
+   rate. Each attempt brackets a CLOCK_MONOTONIC reading between two
+   CLOCK_MONOTONIC_RAW readings, and we keep the tightest bracket.
+
+   Consumers assume that the two clocks' rates differ by no more than
+   max_mono_adj_ppb. If the tick length has been adjusted, or the rate
+   we measure says otherwise, the sample is withheld, and consumers
+   read CLOCK_MONOTONIC_RAW until it is published again. */
+static void sample_mono_raw(byztime_ctx *ctx, timedata_aux *aux) {
+  struct timespec raw1, mono, raw2;
+  int64_t best_width = INT64_MAX;
+
+  for (int attempt = 0; attempt < 3; attempt++) {
+    if (clock_gettime(CLOCK_MONOTONIC_RAW, &raw1) < 0 ||
+        clock_gettime(CLOCK_MONOTONIC, &mono) < 0 ||
+        clock_gettime(CLOCK_MONOTONIC_RAW, &raw2) < 0) {
+      return;
+    }
+    int64_t raw1_ns = (int64_t)raw1.tv_sec * billion + raw1.tv_nsec;
+    int64_t raw2_ns = (int64_t)raw2.tv_sec * billion + raw2.tv_nsec;
+    if (raw2_ns - raw1_ns < best_width) {
+      best_width = raw2_ns - raw1_ns;
+      aux->mono_ref = (int64_t)mono.tv_sec * billion + mono.tv_nsec;
+      aux->raw_ref = raw1_ns + best_width / 2;
+    }
+  }
+  aux->mono_err = best_width / 2 + 1;
+
+  /* Only re-measure the rate over intervals long enough for the
+     bracketing error to be negligible. */
+  if (!ctx->mono_have_prev) {
+    ctx->mono_prev = aux->mono_ref;
+    ctx->raw_prev = aux->raw_ref;
+    ctx->mono_have_prev = true;
+  } else if (aux->mono_ref - ctx->mono_prev >= billion) {
+    int64_t mono_elapsed = aux->mono_ref - ctx->mono_prev;
+    int64_t raw_elapsed = aux->raw_ref - ctx->raw_prev;
+    ctx->mono_rate_ppb =
+        (int64_t)((__int128)(raw_elapsed - mono_elapsed) * billion /
+                  mono_elapsed);
+    ctx->mono_prev = aux->mono_ref;
+    ctx->raw_prev = aux->raw_ref;
+  }
+  aux->mono_rate_ppb = ctx->mono_rate_ppb;
+
+  if (ctx->mono_rate_ppb > max_mono_adj_ppb ||
+      ctx->mono_rate_ppb < -max_mono_adj_ppb ||
+      byztime_mono_adj_bound_ppb() > max_mono_adj_ppb) {
+    aux->mono_err = 0;
+  }
+}
+
+/* Fills in the fixed-point linear model which lets consumers compute the
+   estimate and error bound described by `entry` and the rest of `aux`
+   with integer multiplies and shifts. Leaves it unpublished if the
+   numbers involved don't fit in 64 bits. */
+static void compute_linear_model(timedata_entry const *entry,
+                                 timedata_aux *aux) {
+  int64_t rate_ppb = billion;
+  uint32_t shift = 62;
+  __int128 mult;
+
+  if (stamp_to_ns(&aux->offset_ns, &entry->offset) < 0 ||
+      stamp_to_ns(&aux->error_ns, &entry->error) < 0 ||
+      stamp_to_ns(&aux->as_of_ns, &entry->as_of) < 0) {
+    return;
+  }
+
+  if (aux->slew_end > aux->slew_start) {
+    /* Slewing: follow the slewed estimate until the slew completes. */
+    aux->lin_ref = aux->slew_start;
+    aux->lin_until = aux->slew_end;
+    rate_ppb += aux->slew_rate_ppb;
+    if (__builtin_add_overflow(aux->lin_ref, aux->offset_ns, &aux->lin_base) ||
+        __builtin_add_overflow(aux->lin_base, aux->slew_remaining,
+                               &aux->lin_base)) {
+      return;
+    }
+  } else {
+    aux->lin_ref = aux->as_of_ns;
+    aux->lin_until = INT64_MIN;
+    if (__builtin_add_overflow(aux->lin_ref, aux->offset_ns, &aux->lin_base)) {
+      return;
+    }
+  }
+
+  /* Use the largest shift which keeps the multiplier within 63 bits, so
+     that (local - lin_ref) * lin_mult fits in 128 bits. */
+  do {
+    mult = (((__int128)rate_ppb << shift) + (billion >> 1)) / billion;
+  } while (mult > INT64_MAX && --shift > 0);
+
+  aux->lin_shift = shift;
+  aux->err_mult = drift_ppb_to_err_mult(aux->drift_ppb);
+  aux->lin_mult = (uint64_t)mult;
+}
+
+void byztime_compute_linear_model(timedata_entry const *entry,
+                                  timedata_aux *aux) {
+  compute_linear_model(entry, aux);
+}
+
+/* Decides whether publishing `entry` can be skipped. Must be called with
+   the mutex held.
+
+   The published entry (o_p +/- e_p as of a_p) stays conservative with
+   respect to the new one (o_n +/- e_n as of a_n >= a_p) if
+   |o_n - o_p| + e_n <= e_p: then the published bounds contain the new
+   ones at a_n, and from there on both grow at the same rate, whatever
+   drift rate a consumer assumes. We skip only if that holds, neither
+   offset nor error has moved by the threshold, and the published entry
+   isn't too old. */
+static bool can_coalesce(byztime_ctx *ctx, timedata_entry const *entry) {
+  int i = atomic_load_explicit(&ctx->timedata->i, memory_order_relaxed);
+  timedata_entry const *prev = &ctx->timedata->entries[i];
+  int64_t prev_offset, prev_error, prev_as_of, offset, error, as_of;
+  __int128 offset_change, error_change;
+
+  if (stamp_to_ns(&prev_offset, &prev->offset) < 0 ||
+      stamp_to_ns(&prev_error, &prev->error) < 0 ||
+      stamp_to_ns(&prev_as_of, &prev->as_of) < 0 ||
+      stamp_to_ns(&offset, &entry->offset) < 0 ||
+      stamp_to_ns(&error, &entry->error) < 0 ||
+      stamp_to_ns(&as_of, &entry->as_of) < 0) {
+    return false;
+  }
+
+  if (as_of < prev_as_of ||
+      (__int128)as_of - prev_as_of >= ctx->coalesce_max_interval) {
+    return false;
+  }
+
+  offset_change = (__int128)offset - prev_offset;
+  if (offset_change < 0) offset_change = -offset_change;
+  error_change = (__int128)prev_error - error;
+
+  return offset_change + error <= prev_error &&
+         offset_change < ctx->coalesce_threshold &&
+         error_change < ctx->coalesce_threshold;
+}
+
+/* Publishes a new entry, and if `real_offset` is non-NULL, a new
+   real_offset along with it, in a single critical section. */
+/* Writes `entry` and `aux` to the next slot, with a fresh sequence
+   number, and makes them current. Must be called with the mutex held. */
+static void append_entry(byztime_ctx *ctx, timedata_entry *entry,
+                         timedata_aux *aux) {
+  entry->seq = aux->seq = ++ctx->ext->seq;
+
+  int i = atomic_load_explicit(&ctx->timedata->i, memory_order_acquire) + 1;
+  if (i == NUM_ENTRIES) i = 0;
+  ctx->timedata->entries[i] = *entry;
+  ctx->ext->aux[i] = *aux;
+  atomic_store_explicit(&ctx->timedata->i, i, memory_order_release);
+}
+
+static int publish(byztime_ctx *ctx, byztime_stamp const *offset,
+                   byztime_stamp const *maxerror, byztime_stamp const *as_of,
+                   byztime_stamp const *real_offset) {
+  timedata_entry entry;
+  timedata_aux aux;
+  byztime_stamp local_time;
+  int64_t now_ns = 0;
+  int ret;
+
+  if (ctx->standby) {
+    errno = EPERM;
+    return -1;
+  }
+
+  memset(&entry, 0, sizeof entry);
+  memset(&aux, 0, sizeof aux);
+
+  entry.offset = *offset;
+  entry.error = *maxerror;
+
+  if (as_of == NULL || ctx->provider_slew) {
+    if (byztime_get_local_time(&local_time) < 0 ||
+        stamp_to_ns(&now_ns, &local_time) < 0) {
+      return -1;
+    }
+  }
+
+  entry.as_of = as_of == NULL ? local_time : *as_of;
+
+  ret = pthread_mutex_lock(&ctx->timedata->mutex);
   if (ret != 0) {
     errno = ret;
-    goto fail_unmap;
+    return -1;
   }
 
-  ret = pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+  if (ctx->drift_estimation) {
+    aux.drift_ppb = estimate_drift(ctx, &entry.offset, &entry.error,
+                                   &entry.as_of);
+  }
+
+  if (real_offset != NULL) ctx->timedata->real_offset = *real_offset;
+
+  if (ctx->coalesce) {
+    if (can_coalesce(ctx, &entry)) {
+      ctx->coalesce_saved++;
+      ret = pthread_mutex_unlock(&ctx->timedata->mutex);
+      if (ret != 0) {
+        errno = ret;
+        return -1;
+      }
+      return 0;
+    }
+    ctx->coalesce_published++;
+  }
+
+  if (ctx->provider_slew) compute_slew(ctx, &entry, &aux, now_ns);
+  compute_linear_model(&entry, &aux);
+  sample_mono_raw(ctx, &aux);
+  aux.real_offset = ctx->timedata->real_offset;
+  aux.has_real_offset = 1;
+
+  append_entry(ctx, &entry, &aux);
+  ret = pthread_mutex_unlock(&ctx->timedata->mutex);
   if (ret != 0) {
     errno = ret;
+    return -1;
+  }
+
+  return 0;
+}
+
+int byztime_set_offset(byztime_ctx *ctx, byztime_stamp const *offset,
+                       byztime_stamp const *maxerror,
+                       byztime_stamp const *as_of) {
+  return publish(ctx, offset, maxerror, as_of, NULL);
+}
+
+int byztime_publish(byztime_ctx *ctx, byztime_stamp const *offset,
+                    byztime_stamp const *maxerror, byztime_stamp const *as_of,
+                    byztime_stamp const *real_offset) {
+  byztime_stamp local_time, real_time, global_time, computed;
+
+  if (real_offset == NULL) {
+    /* The new entry's estimate of global time is local time plus its
+       offset, however old the measurement is. */
+    if (byztime_get_local_time(&local_time) < 0 ||
+        byztime_get_real_time(&real_time) < 0 ||
+        byztime_stamp_add(&global_time, &local_time, offset) < 0 ||
+        byztime_stamp_sub(&computed, &global_time, &real_time) < 0) {
+      return -1;
+    }
+    real_offset = &computed;
+  }
+
+  return publish(ctx, offset, maxerror, as_of, real_offset);
+}
+
+int byztime_provider_slew(byztime_ctx *ctx, int64_t min_rate_ppb,
+                          int64_t max_rate_ppb,
+                          byztime_stamp const *maxerror) {
+  byztime_stamp error;
+
+  if (min_rate_ppb < 0 || min_rate_ppb > billion || max_rate_ppb < billion) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  byztime_get_offset_raw(ctx, NULL, &error, NULL);
+  if (maxerror != NULL && byztime_stamp_cmp(&error, maxerror) > 0) {
+    errno = ERANGE;
+    return -1;
+  }
+
+  ctx->provider_min_rate_ppb = min_rate_ppb;
+  ctx->provider_max_rate_ppb = max_rate_ppb;
+  ctx->provider_slew = true;
+  return 0;
+}
+
+int byztime_provider_step(byztime_ctx *ctx) {
+  ctx->provider_slew = false;
+  return 0;
+}
+
+int byztime_provider_estimate_drift(byztime_ctx *ctx,
+                                    byztime_stamp const *window) {
+  int64_t window_ns;
+
+  if (window == NULL) {
+    ctx->drift_estimation = false;
+    return 0;
+  }
+
+  if (stamp_to_ns(&window_ns, window) < 0) return -1;
+  if (window_ns <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctx->drift_window = window_ns;
+  ctx->drift_nsamples = 0;
+  ctx->drift_head = 0;
+  ctx->drift_estimation = true;
+  return 0;
+}
+
+/* Hot standby.
+
+   A standby maps the timedata file read-write and opens the lock file
+   without locking it, so that everything a takeover needs is already
+   in place except the lock itself. The kernel releases the primary's
+   lock the moment it dies, and a blocked flock() then returns straight
+   away. While it waits, the standby follows the primary's entries so
+   that its drift estimator history and CLOCK_MONOTONIC rate
+   measurement carry on seamlessly; the slew state that matters lives
+   in the page already. */
+
+byztime_ctx *byztime_open_standby(char const *pathname) {
+  byztime_ctx *ctx;
+  unsigned char expected_era[BYZTIME_ERA_LEN], stored_era[BYZTIME_ERA_LEN];
+  unsigned char stored_magic[BYZTIME_MAGIC_LEN];
+  struct stat statbuf;
+  int saved_errno, ret;
+
+  if (byztime_init_sigbus_key() < 0) return NULL;
+
+  if (byztime_get_clock_era(expected_era) < 0) return NULL;
+
+  ctx = malloc(sizeof(byztime_ctx));
+  if (ctx == NULL) return NULL;
+
+  ctx->fd = open(pathname, O_RDWR);
+  if (ctx->fd < 0) goto fail_free_ctx;
+
+  ctx->map_len = sizeof(timedata) + sizeof(timedata_ext);
+
+  if (fstat(ctx->fd, &statbuf) < 0) goto fail_close;
+  if (statbuf.st_size < (off_t)ctx->map_len) {
+    errno = EPROTO;
+    goto fail_close;
+  }
+
+  ctx->lock_fd = open_lock_file(pathname);
+  if (ctx->lock_fd < 0) goto fail_close;
+
+  /* Prefault the mapping so that the first publish after a takeover
+     doesn't take page faults. */
+  ctx->timedata = mmap(NULL, ctx->map_len, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ctx->fd, 0);
+  if (ctx->timedata == MAP_FAILED) goto fail_close_lock;
+  ctx->ext = (timedata_ext *)(ctx->timedata + 1);
+
+  load_magic(stored_magic, &ctx->timedata->magic);
+  if (memcmp(stored_magic, expected_magic, sizeof expected_magic)) {
+    errno = EPROTO;
     goto fail_unmap;
   }
 
-  ret = pthread_mutex_init(&ctx->timedata->mutex, &mutex_attr);
-  if (ret != 0) {
-    errno = ret;
+  load_magic(stored_magic, &ctx->ext->magic);
+  if (memcmp(stored_magic, expected_ext_magic, sizeof expected_ext_magic)) {
+    errno = EPROTO;
     goto fail_unmap;
   }
 
+  load_era(stored_era, &ctx->timedata->era);
+  if (memcmp(stored_era, expected_era, sizeof expected_era)) {
+    errno = ECONNREFUSED;
+    goto fail_unmap;
+  }
+
+  init_provider_state(ctx);
+  ctx->standby = true;
+  ctx->standby_seq = 0;
+
   return ctx;
 
 fail_unmap:
   saved_errno = errno;
-  ret = munmap(ctx->timedata, sizeof(timedata));
+  ret = munmap(ctx->timedata, ctx->map_len);
   assert(ret == 0);
   errno = saved_errno;
-fail_release_lock:
+fail_close_lock:
   saved_errno = errno;
   close(ctx->lock_fd);
   errno = saved_errno;
@@ -198,40 +754,203 @@ fail_free_ctx:
   return NULL;
 }
 
-int byztime_set_offset(byztime_ctx *ctx, byztime_stamp const *offset,
-                       byztime_stamp const *maxerror,
-                       byztime_stamp const *as_of) {
+/* Absorbs the primary's current entry into our own state if we haven't
+   seen it yet. */
+static int standby_absorb(byztime_ctx *ctx) {
   timedata_entry entry;
-  int ret;
+  timedata_aux aux;
 
-  memset(&entry, 0, sizeof entry);
+  if (byztime_load_entry(ctx, &entry, &aux) < 0) return -1;
+  if (entry.seq == 0 || entry.seq == ctx->standby_seq) return 0;
+  ctx->standby_seq = entry.seq;
 
-  entry.offset = *offset;
-  entry.error = *maxerror;
+  /* The exception to estimate_drift()'s locking rule: a standby can't
+     take the mutex, which a dying primary may leave locked, but nor can
+     it publish, so nothing else touches its history until takeover. */
+  if (ctx->drift_estimation) {
+    estimate_drift(ctx, &entry.offset, &entry.error, &entry.as_of);
+  }
 
-  if (as_of == NULL) {
-    byztime_stamp local_time;
-    if (byztime_get_local_time(&local_time) < 0) return -1;
-    entry.as_of = local_time;
-  } else {
-    entry.as_of = *as_of;
+  if (aux.mono_err > 0) {
+    ctx->mono_prev = aux.mono_ref;
+    ctx->raw_prev = aux.raw_ref;
+    ctx->mono_rate_ppb = aux.mono_rate_ppb;
+    ctx->mono_have_prev = true;
   }
 
-  ret = pthread_mutex_lock(&ctx->timedata->mutex);
+  return 0;
+}
+
+int byztime_standby_poll(byztime_ctx *ctx) {
+  if (!ctx->standby) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return standby_absorb(ctx);
+}
+
+int byztime_standby_takeover(byztime_ctx *ctx, int block) {
+  int saved_errno;
+
+  if (!ctx->standby) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (flock(ctx->lock_fd, block ? LOCK_EX : LOCK_EX | LOCK_NB) < 0) return -1;
+
+  /* The primary may have died holding the mutex. Now that we hold the
+     file lock, nobody else can be using it. */
+  if (init_mutex(ctx) < 0) {
+    saved_errno = errno;
+    flock(ctx->lock_fd, LOCK_UN);
+    errno = saved_errno;
+    return -1;
+  }
+
+  /* Pick up whatever the primary published since our last poll. A
+     failure here only costs us some warmth, so it isn't fatal. */
+  saved_errno = errno;
+  standby_absorb(ctx);
+  errno = saved_errno;
+
+  ctx->standby = false;
+  return 0;
+}
+
+int byztime_provider_coalesce(byztime_ctx *ctx, byztime_stamp const *threshold,
+                              byztime_stamp const *max_interval) {
+  int64_t threshold_ns, max_interval_ns;
+
+  if (threshold == NULL || max_interval == NULL) {
+    ctx->coalesce = false;
+    return 0;
+  }
+
+  if (stamp_to_ns(&threshold_ns, threshold) < 0 ||
+      stamp_to_ns(&max_interval_ns, max_interval) < 0) {
+    return -1;
+  }
+  if (threshold_ns < 0 || max_interval_ns < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ctx->coalesce_threshold = threshold_ns;
+  ctx->coalesce_max_interval = max_interval_ns;
+  ctx->coalesce_published = 0;
+  ctx->coalesce_saved = 0;
+  ctx->coalesce = true;
+  return 0;
+}
+
+void byztime_provider_coalesce_stats(byztime_ctx const *ctx,
+                                     uint64_t *published, uint64_t *saved) {
+  if (published != NULL) *published = ctx->coalesce_published;
+  if (saved != NULL) *saved = ctx->coalesce_saved;
+}
+
+/* Coarse global-time tick.
+
+   The tick thread periodically computes global time and stores it in a
+   seqlock-protected cache line of the extension header, along with a
+   CLOCK_MONOTONIC_COARSE reading taken just before the computation, so
+   that a consumer can tell how stale it is with nothing more than a
+   vDSO read of that clock. We are the only writer of the line. */
+
+static void *tick_main(void *arg) {
+  byztime_ctx *ctx = arg;
+  timedata_tick *tick = &ctx->ext->tick;
+  struct timespec next, res;
+  int64_t res_ns = 0;
+
+  if (clock_getres(CLOCK_MONOTONIC_COARSE, &res) == 0) {
+    res_ns = (int64_t)res.tv_sec * billion + res.tv_nsec;
+  }
+  if (clock_gettime(CLOCK_MONOTONIC, &next) < 0) return NULL;
+
+  while (!atomic_load_explicit(&ctx->tick_stop, memory_order_acquire)) {
+    struct timespec coarse;
+    int64_t min, est, max;
+    int64_t adj_ppb = byztime_mono_adj_bound_ppb();
+
+    if (clock_gettime(CLOCK_MONOTONIC_COARSE, &coarse) == 0 &&
+        byztime_get_global_time_ns(ctx, &min, &est, &max) == 0) {
+      uint_fast64_t seq =
+          atomic_load_explicit(&tick->seq, memory_order_relaxed);
+      atomic_store_explicit(&tick->seq, seq + 1, memory_order_relaxed);
+      atomic_thread_fence(memory_order_release);
+      tick->min = min;
+      tick->est = est;
+      tick->max = max;
+      tick->coarse_ns = (int64_t)coarse.tv_sec * billion + coarse.tv_nsec;
+      tick->period_ns = ctx->tick_period_ns;
+      tick->res_ns = res_ns;
+      tick->adj_ppb = adj_ppb;
+      atomic_store_explicit(&tick->seq, seq + 2, memory_order_release);
+    }
+
+    next.tv_sec += ctx->tick_period_ns / billion;
+    next.tv_nsec += ctx->tick_period_ns % billion;
+    if (next.tv_nsec >= billion) {
+      next.tv_sec++;
+      next.tv_nsec -= billion;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) ==
+           EINTR)
+      ;
+  }
+
+  return NULL;
+}
+
+int byztime_provider_start_tick(byztime_ctx *ctx,
+                                byztime_stamp const *period) {
+  int64_t period_ns;
+  int ret;
+
+  if (ctx->standby || ctx->ext == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if (stamp_to_ns(&period_ns, period) < 0) return -1;
+  if (period_ns <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (byztime_provider_stop_tick(ctx) < 0) return -1;
+
+  ctx->tick_period_ns = period_ns;
+  atomic_init(&ctx->tick_stop, false);
+  atomic_store_explicit(&ctx->ext->tick.seq, 0, memory_order_release);
+
+  ret = pthread_create(&ctx->tick_thread, NULL, tick_main, ctx);
   if (ret != 0) {
     errno = ret;
     return -1;
   }
-  int i = atomic_load_explicit(&ctx->timedata->i, memory_order_acquire) + 1;
-  if (i == NUM_ENTRIES) i = 0;
-  ctx->timedata->entries[i] = entry;
-  atomic_store_explicit(&ctx->timedata->i, i, memory_order_release);
-  ret = pthread_mutex_unlock(&ctx->timedata->mutex);
+
+  ctx->tick_running = true;
+  return 0;
+}
+
+int byztime_provider_stop_tick(byztime_ctx *ctx) {
+  int ret;
+
+  if (!ctx->tick_running) return 0;
+
+  atomic_store_explicit(&ctx->tick_stop, true, memory_order_release);
+  ret = pthread_join(ctx->tick_thread, NULL);
   if (ret != 0) {
     errno = ret;
     return -1;
   }
 
+  ctx->tick_running = false;
+  atomic_store_explicit(&ctx->ext->tick.seq, 0, memory_order_release);
   return 0;
 }
 
@@ -248,7 +967,14 @@ void byztime_get_offset_raw(byztime_ctx const *ctx, byztime_stamp *offset,
 
 int byztime_update_real_offset(byztime_ctx *ctx) {
   byztime_stamp real_time, global_time;
-  int ret;
+  timedata_entry entry;
+  timedata_aux aux;
+  int i, ret;
+
+  if (ctx->standby) {
+    errno = EPERM;
+    return -1;
+  }
 
   if (byztime_get_global_time(ctx, NULL, &global_time, NULL) < 0 ||
       byztime_get_real_time(&real_time)) {
@@ -267,6 +993,17 @@ int byztime_update_real_offset(byztime_ctx *ctx) {
     return -1;
   }
 
+  /* Consumers read real_offset from the current entry's aux record, so
+     republish that entry with the new value rather than leave it stale
+     until the next publish, which coalescing may put off for a while. */
+  i = atomic_load_explicit(&ctx->timedata->i, memory_order_acquire);
+  entry = ctx->timedata->entries[i];
+  aux = ctx->ext->aux[i];
+  if (entry.seq == 0 || aux.seq != entry.seq) memset(&aux, 0, sizeof aux);
+  aux.real_offset = ctx->timedata->real_offset;
+  aux.has_real_offset = 1;
+  append_entry(ctx, &entry, &aux);
+
   ret = pthread_mutex_unlock(&ctx->timedata->mutex);
   if (ret != 0) {
     errno = ret;
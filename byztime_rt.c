@@ -0,0 +1,273 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _GNU_SOURCE
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+/* Real-time publishing.
+
+   Whatever delays a call to byztime_set_offset() between the moment the
+   measurement is complete and the moment the new entry becomes visible
+   is error that consumers must absorb, and a provider's measurement
+   thread is a poor place to make that call: it does network I/O,
+   allocates, and may be preempted by anything. So the measurement
+   thread instead drops the new offset into a single-producer,
+   single-consumer ring and posts a semaphore, and a dedicated thread,
+   optionally running under SCHED_FIFO on a CPU of its own with all
+   memory locked, does the publishing.
+
+   The ring is a fixed array of slots with a head index owned by the
+   publisher and a tail index owned by the producer, each on its own
+   cache line. A newer offset makes older ones worthless, so when the
+   publisher finds several slots waiting it publishes only the newest. */
+
+#define RT_QUEUE_LEN 256
+#define RT_CACHE_LINE 64
+
+/* How much of its stack the publisher touches at startup, so that it
+   won't take page faults on it later. */
+#define RT_STACK_PREFAULT 65536
+
+struct byztime_rt_publisher_s {
+  _Alignas(RT_CACHE_LINE) atomic_size_t head;
+  _Alignas(RT_CACHE_LINE) atomic_size_t tail;
+  _Alignas(RT_CACHE_LINE) atomic_bool stop;
+  byztime_ctx *ctx;
+  pthread_t thread;
+  sem_t wakeup;
+  atomic_uint_fast64_t enqueued;
+  atomic_uint_fast64_t dropped;
+  atomic_uint_fast64_t published;
+  atomic_uint_fast64_t superseded;
+  atomic_uint_fast64_t failed;
+  atomic_int last_error;
+  atomic_uint_fast64_t latency_hist[BYZTIME_RT_HIST_BUCKETS];
+  rt_slot slots[RT_QUEUE_LEN];
+};
+
+static int64_t raw_now_ns(void) {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts) < 0) return 0;
+  return (int64_t)ts.tv_sec * billion + ts.tv_nsec;
+}
+
+/* Returns floor(log2(ns)), or 0 if ns < 2. */
+static int latency_bucket(int64_t ns) {
+  if (ns < 2) return 0;
+  return 63 - __builtin_clzll((unsigned long long)ns);
+}
+
+static void prefault_stack(void) {
+  volatile char buf[RT_STACK_PREFAULT];
+  memset((char *)buf, 0, sizeof buf);
+}
+
+static void *publisher_main(void *arg) {
+  byztime_rt_publisher *pub = arg;
+  bool stopping = false;
+
+  prefault_stack();
+
+  while (!stopping) {
+    size_t head, tail;
+    rt_slot slot;
+    int64_t latency;
+
+    while (sem_wait(&pub->wakeup) < 0 && errno == EINTR)
+      ;
+
+    /* Read the stop flag before the ring, so that anything enqueued
+       before byztime_rt_stop() is published before we exit. */
+    stopping = atomic_load_explicit(&pub->stop, memory_order_acquire);
+
+    head = atomic_load_explicit(&pub->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&pub->tail, memory_order_acquire);
+    if (head == tail) continue;
+
+    slot = pub->slots[(tail - 1) % RT_QUEUE_LEN];
+    atomic_store_explicit(&pub->head, tail, memory_order_release);
+    if (tail - head > 1) {
+      atomic_fetch_add_explicit(&pub->superseded, tail - head - 1,
+                                memory_order_relaxed);
+    }
+
+    if (byztime_set_offset(pub->ctx, &slot.offset, &slot.error,
+                           &slot.as_of) < 0) {
+      atomic_store_explicit(&pub->last_error, errno, memory_order_relaxed);
+      atomic_fetch_add_explicit(&pub->failed, 1, memory_order_relaxed);
+      continue;
+    }
+
+    latency = raw_now_ns() - slot.enqueued_ns;
+    atomic_fetch_add_explicit(&pub->latency_hist[latency_bucket(latency)], 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&pub->published, 1, memory_order_relaxed);
+  }
+
+  return NULL;
+}
+
+byztime_rt_publisher *byztime_rt_start(byztime_ctx *ctx, int cpu, int priority,
+                                       int flags) {
+  byztime_rt_publisher *pub;
+  pthread_attr_t attr;
+  void *mem;
+  int ret;
+
+  if ((flags & ~BYZTIME_RT_MLOCKALL) != 0 || priority < 0 ||
+      (priority > 0 && (priority < sched_get_priority_min(SCHED_FIFO) ||
+                        priority > sched_get_priority_max(SCHED_FIFO))) ||
+      cpu >= CPU_SETSIZE) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if ((flags & BYZTIME_RT_MLOCKALL) && mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+    return NULL;
+
+  ret = posix_memalign(&mem, RT_CACHE_LINE, sizeof(byztime_rt_publisher));
+  if (ret != 0) {
+    errno = ret;
+    return NULL;
+  }
+  pub = mem;
+  memset(pub, 0, sizeof *pub);
+  atomic_init(&pub->head, 0);
+  atomic_init(&pub->tail, 0);
+  atomic_init(&pub->stop, false);
+  pub->ctx = ctx;
+
+  if (sem_init(&pub->wakeup, 0, 0) < 0) {
+    free(pub);
+    return NULL;
+  }
+
+  ret = pthread_attr_init(&attr);
+  if (ret != 0) goto fail_sem;
+
+  if (priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof param);
+    param.sched_priority = priority;
+    ret = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    if (ret == 0) ret = pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    if (ret == 0) ret = pthread_attr_setschedparam(&attr, &param);
+    if (ret != 0) goto fail_attr;
+  }
+
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    ret = pthread_attr_setaffinity_np(&attr, sizeof set, &set);
+    if (ret != 0) goto fail_attr;
+  }
+
+  ret = pthread_create(&pub->thread, &attr, publisher_main, pub);
+  if (ret != 0) goto fail_attr;
+
+  pthread_attr_destroy(&attr);
+  return pub;
+
+fail_attr:
+  pthread_attr_destroy(&attr);
+fail_sem:
+  sem_destroy(&pub->wakeup);
+  free(pub);
+  errno = ret;
+  return NULL;
+}
+
+/* Fills in `slot` for an offset being enqueued now. A NULL `as_of` is
+   resolved here rather than by the publisher, so that however long the
+   offset waits in the ring is counted against its error. */
+static inline int fill_slot(rt_slot *slot, byztime_stamp const *offset,
+                            byztime_stamp const *error,
+                            byztime_stamp const *as_of) {
+  if (as_of == NULL) {
+    if (byztime_get_local_time(&slot->as_of) < 0) return -1;
+  } else {
+    slot->as_of = *as_of;
+  }
+  slot->offset = *offset;
+  slot->error = *error;
+  slot->enqueued_ns = raw_now_ns();
+  return 0;
+}
+
+int byztime_rt_fill_slot(rt_slot *slot, byztime_stamp const *offset,
+                         byztime_stamp const *error,
+                         byztime_stamp const *as_of) {
+  return fill_slot(slot, offset, error, as_of);
+}
+
+int byztime_rt_enqueue(byztime_rt_publisher *pub, byztime_stamp const *offset,
+                       byztime_stamp const *error,
+                       byztime_stamp const *as_of) {
+  size_t head, tail;
+
+  tail = atomic_load_explicit(&pub->tail, memory_order_relaxed);
+  head = atomic_load_explicit(&pub->head, memory_order_acquire);
+  if (tail - head >= RT_QUEUE_LEN) {
+    atomic_fetch_add_explicit(&pub->dropped, 1, memory_order_relaxed);
+    errno = EAGAIN;
+    return -1;
+  }
+
+  if (fill_slot(&pub->slots[tail % RT_QUEUE_LEN], offset, error, as_of) < 0)
+    return -1;
+
+  atomic_store_explicit(&pub->tail, tail + 1, memory_order_release);
+  atomic_fetch_add_explicit(&pub->enqueued, 1, memory_order_relaxed);
+  return sem_post(&pub->wakeup);
+}
+
+void byztime_rt_get_stats(byztime_rt_publisher const *pub,
+                          byztime_rt_stats *stats) {
+  /* The counters are only ever incremented, so a cast away from const
+     to load them is harmless. */
+  byztime_rt_publisher *p = (byztime_rt_publisher *)pub;
+
+  stats->enqueued = atomic_load_explicit(&p->enqueued, memory_order_relaxed);
+  stats->dropped = atomic_load_explicit(&p->dropped, memory_order_relaxed);
+  stats->published = atomic_load_explicit(&p->published, memory_order_relaxed);
+  stats->superseded =
+      atomic_load_explicit(&p->superseded, memory_order_relaxed);
+  stats->failed = atomic_load_explicit(&p->failed, memory_order_relaxed);
+  stats->last_error =
+      atomic_load_explicit(&p->last_error, memory_order_relaxed);
+  for (int k = 0; k < BYZTIME_RT_HIST_BUCKETS; k++) {
+    stats->latency_hist[k] =
+        atomic_load_explicit(&p->latency_hist[k], memory_order_relaxed);
+  }
+}
+
+int byztime_rt_stop(byztime_rt_publisher *pub) {
+  int ret;
+
+  if (pub == NULL) return 0;
+
+  atomic_store_explicit(&pub->stop, true, memory_order_release);
+  if (sem_post(&pub->wakeup) < 0) return -1;
+
+  ret = pthread_join(pub->thread, NULL);
+  if (ret != 0) {
+    errno = ret;
+    return -1;
+  }
+
+  sem_destroy(&pub->wakeup);
+  free(pub);
+  return 0;
+}
@@ -36,131 +36,84 @@ int byztime_stamp_normalize(byztime_stamp *stamp) {
     return 0;
   }
 }
-int byztime_stamp_add(byztime_stamp *sum, byztime_stamp const *stamp1,
-                      byztime_stamp const *stamp2) {
-  bool overflow = false;
-  byztime_stamp s1 = *stamp1, s2 = *stamp2;
-
-  if (byztime_stamp_normalize(&s1) < 0) {
-    assert(errno == EOVERFLOW);
-    overflow = true;
-  }
-
-  if (byztime_stamp_normalize(&s2) < 0) {
-    assert(errno == EOVERFLOW);
-    overflow = true;
-  }
-
-  overflow |= __builtin_add_overflow(s1.seconds, s2.seconds, &sum->seconds);
-  sum->nanoseconds = s1.nanoseconds + s2.nanoseconds;
-
-  if (byztime_stamp_normalize(sum) < 0) {
-    assert(errno == EOVERFLOW);
-    overflow = true;
-  }
+/* Normalizes a stamp exactly, into seconds that are widened so that
+   they can't overflow and nanoseconds in [0, 1000000000). */
+static inline void stamp_widen(byztime_stamp const *stamp, __int128 *seconds,
+                               int64_t *nanoseconds) {
+  int64_t nsec_div = stamp->nanoseconds / billion;
+  int64_t nsec_mod = stamp->nanoseconds % billion;
 
-  if (overflow) {
-    errno = EOVERFLOW;
-    return -1;
+  if (nsec_mod < 0) {
+    nsec_mod += billion;
+    nsec_div--;
   }
-
-  return 0;
+  *seconds = (__int128)stamp->seconds + nsec_div;
+  *nanoseconds = nsec_mod;
 }
 
-int byztime_stamp_sub(byztime_stamp *diff, byztime_stamp const *stamp1,
-                      byztime_stamp const *stamp2) {
-  bool overflow = false;
-  byztime_stamp s1 = *stamp1, s2 = *stamp2;
-
-  if (byztime_stamp_normalize(&s1) < 0) {
-    assert(errno == EOVERFLOW);
-    overflow = true;
-  }
-
-  if (byztime_stamp_normalize(&s2) < 0) {
-    assert(errno == EOVERFLOW);
-    overflow = true;
+/* Stores seconds + nanoseconds, normalized. If the seconds don't fit in
+   64 bits, stores them with 2-complement wraparound and fails with
+   EOVERFLOW. */
+static inline int stamp_narrow(byztime_stamp *stamp, __int128 seconds,
+                               int64_t nanoseconds) {
+  seconds += nanoseconds / billion;
+  nanoseconds %= billion;
+  if (nanoseconds < 0) {
+    nanoseconds += billion;
+    seconds--;
   }
 
-  overflow |= __builtin_sub_overflow(s1.seconds, s2.seconds, &diff->seconds);
-  diff->nanoseconds = s1.nanoseconds - s2.nanoseconds;
+  stamp->seconds = (int64_t)(uint64_t)seconds;
+  stamp->nanoseconds = nanoseconds;
 
-  if (byztime_stamp_normalize(diff) < 0) {
-    assert(errno == EOVERFLOW);
-    overflow = true;
-  }
-
-  if (overflow) {
+  if (seconds < INT64_MIN || seconds > INT64_MAX) {
     errno = EOVERFLOW;
     return -1;
   }
-
   return 0;
 }
 
-/** Faster version of byztime_stamp_scale for when 0 <= ppb <= 1_000_000_000. */
-static int byztime_stamp_downscale(byztime_stamp *prod,
-                                   byztime_stamp const *stamp, int64_t ppb) {
-  byztime_stamp s = *stamp;
-  bool overflowed = false;
-
-  if (byztime_stamp_normalize(&s) < 0) {
-    assert(errno == EOVERFLOW);
-    overflowed = true;
-  }
-
-  int64_t gigaseconds_in = s.seconds / billion;
-  int64_t seconds_in = s.seconds % billion;
-  int64_t nanoseconds_in = s.nanoseconds;
-
-  int64_t nanoparts = ppb;
-  assert(nanoparts >= 0 && nanoparts <= billion);
+/* Addition, subtraction and scaling carry their intermediates in wide
+   seconds, so that they fail only if the result itself is out of
+   range, never because an intermediate was, and accept unnormalized
+   inputs even where normalizing them alone would overflow. */
 
-  int64_t seconds_out = gigaseconds_in * nanoparts;
-  ;
-  int64_t nanoseconds_out = seconds_in * nanoparts;
-  int64_t attoseconds_out = nanoseconds_in * nanoparts;
-
-  prod->seconds = seconds_out;
-  prod->nanoseconds = nanoseconds_out + attoseconds_out / billion;
+int byztime_stamp_add(byztime_stamp *sum, byztime_stamp const *stamp1,
+                      byztime_stamp const *stamp2) {
+  __int128 s1, s2;
+  int64_t ns1, ns2;
 
-  int64_t residue = attoseconds_out % billion;
-  if (residue > (billion >> 1) ||
-      (residue == (billion >> 1) && (prod->nanoseconds & 1))) {
-    prod->nanoseconds++;
-  } else if (residue < -(billion >> 1) ||
-             (residue == -(billion >> 1) && (prod->nanoseconds & 1))) {
-    prod->nanoseconds--;
-  }
+  stamp_widen(stamp1, &s1, &ns1);
+  stamp_widen(stamp2, &s2, &ns2);
+  return stamp_narrow(sum, s1 + s2, ns1 + ns2);
+}
 
-  if (byztime_stamp_normalize(prod) < 0) { assert(false); }
+int byztime_stamp_sub(byztime_stamp *diff, byztime_stamp const *stamp1,
+                      byztime_stamp const *stamp2) {
+  __int128 s1, s2;
+  int64_t ns1, ns2;
 
-  if (overflowed) {
-    errno = EOVERFLOW;
-    return -1;
-  } else {
-    return 0;
-  }
+  stamp_widen(stamp1, &s1, &ns1);
+  stamp_widen(stamp2, &s2, &ns2);
+  return stamp_narrow(diff, s1 - s2, ns1 - ns2);
 }
 
 int byztime_stamp_scale(byztime_stamp *prod, byztime_stamp const *stamp,
                         int64_t ppb) {
-  if (ppb >= 0 && ppb <= billion) {
-    return byztime_stamp_downscale(prod, stamp, ppb);
-  }
-
-  byztime_stamp s = *stamp;
-  bool overflowed = false;
+  int64_t nsec_div = stamp->nanoseconds / billion;
+  int64_t nanoseconds_in = stamp->nanoseconds % billion;
 
-  if (byztime_stamp_normalize(&s) < 0) {
-    assert(errno == EOVERFLOW);
-    overflowed = true;
+  if (nanoseconds_in < 0) {
+    nanoseconds_in += billion;
+    nsec_div--;
   }
 
-  /* We'll do schoolbook multiplication where these three places... */
-  int64_t gigaseconds_in = s.seconds / billion;
-  int64_t seconds_in = s.seconds % billion;
-  int64_t nanoseconds_in = s.nanoseconds;
+  /* We'll do schoolbook multiplication where these three places... The
+     carry out of the nanoseconds is folded into the seconds place, which
+     can't overflow since both are far smaller than INT64_MAX. */
+  int64_t seconds_in = stamp->seconds % billion + nsec_div;
+  int64_t gigaseconds_in = stamp->seconds / billion + seconds_in / billion;
+  seconds_in %= billion;
 
   /* ...are each multiplied by each these two places... */
   int64_t parts = ppb / billion;
@@ -168,74 +121,35 @@ int byztime_stamp_scale(byztime_stamp *prod, byztime_stamp const *stamp,
 
   /* ...producing six outputs: one on the scale of gigaseconds, two on
      the scale of seconds, two on the scale of nanoseconds, and one on
-     the scale of attoseconds */
-  int64_t gigaseconds_out;
-  int64_t seconds_out_1, seconds_out_2;
-  int64_t nanoseconds_out_1, nanoseconds_out_2;
-  int64_t attoseconds_out;
-
-  overflowed |= __builtin_mul_overflow(gigaseconds_in, parts, &gigaseconds_out);
-
-  /* The following operations can't overflow because their factors are
-     either a quotient (Q) and a remainder (R) from division by one
-     billion, or two remainders from the same */
-  seconds_out_1 = seconds_in /*R*/ * parts /*Q*/;
-  seconds_out_2 = gigaseconds_in /*Q*/ * nanoparts /*R*/;
-  nanoseconds_out_1 = seconds_in /*R*/ * nanoparts /*R*/;
-  nanoseconds_out_2 = nanoseconds_in /*R*/ * parts /*Q*/;
-  attoseconds_out = nanoseconds_in /*R*/ * nanoparts /*R*/;
-
-  /* We multiply the gigaseconds place by one billion to convert it to seconds,
-     and then add it to the other seconds-scale outputs to get the product
-     seconds field. */
-  overflowed |=
-      __builtin_mul_overflow(gigaseconds_out, billion, &prod->seconds);
-  overflowed |=
-      __builtin_add_overflow(prod->seconds, seconds_out_1, &prod->seconds);
-  overflowed |=
-      __builtin_add_overflow(prod->seconds, seconds_out_2, &prod->seconds);
-
-  /* We divide the attoseconds place by one billion to convert it to
-     nanoseconds, and add it to the other nanosecond-scale outputs to
-     get the product nanoseconds field.
-
-     attoseconds_out / billion is bounded by one billion, and
-     nanoseconds_out_1 is bounded by one quintiillion, but
-     nanoseconds_out_2 might be as big as INT64_MAX. So to prevent an
-     unnecessary overflow, we need to first set the nanoseconds to
-     nanoseconds_out_2 and then renormalize before adding in the other
-     terms. But afterwards, the addition can be unchecked. */
-  prod->nanoseconds = nanoseconds_out_2;
-  if (byztime_stamp_normalize(prod) < 0) {
-    assert(errno == EOVERFLOW);
-    overflowed = true;
-  }
-  prod->nanoseconds += attoseconds_out / billion + nanoseconds_out_1;
-
-  /* Now we possibly make a +/- 1 adjustment due to rounding. This can
-     again be unchecked since we haven't added anything large to our
-     nanoseconds since having last normalized. */
+     the scale of attoseconds. The nanosecond- and attosecond-scale
+     ones fit in 64 bits because their factors are each a quotient (Q)
+     and a remainder (R) from division by one billion, or two remainders
+     from the same. The rest are formed in 128 bits. */
+  __int128 seconds_out = (__int128)gigaseconds_in * parts * billion +
+                         (__int128)seconds_in * parts +
+                         (__int128)gigaseconds_in * nanoparts;
+  int64_t nanoseconds_out_1 = seconds_in /*R*/ * nanoparts /*R*/;
+  int64_t nanoseconds_out_2 = nanoseconds_in /*R*/ * parts /*Q*/;
+  int64_t attoseconds_out = nanoseconds_in /*R*/ * nanoparts /*R*/;
+
+  /* nanoseconds_out_2 might be as big as INT64_MAX, so fold its whole
+     seconds into seconds_out before adding in the other terms. */
+  seconds_out += nanoseconds_out_2 / billion;
+  int64_t nanoseconds_out = nanoseconds_out_2 % billion + nanoseconds_out_1 +
+                            attoseconds_out / billion;
+
+  /* Now we possibly make a +/- 1 adjustment due to rounding, to nearest
+     with ties to even. */
   int64_t residue = attoseconds_out % billion;
   if (residue > (billion >> 1) ||
-      (residue == (billion >> 1) && (prod->nanoseconds & 1))) {
-    prod->nanoseconds++;
+      (residue == (billion >> 1) && (nanoseconds_out & 1))) {
+    nanoseconds_out++;
   } else if (residue < -(billion >> 1) ||
-             (residue == -(billion >> 1) && (prod->nanoseconds & 1))) {
-    prod->nanoseconds--;
-  }
-
-  /* Now we're finished after normalizing for the final time. */
-  if (byztime_stamp_normalize(prod) < 0) {
-    assert(errno == EOVERFLOW);
-    overflowed = true;
+             (residue == -(billion >> 1) && (nanoseconds_out & 1))) {
+    nanoseconds_out--;
   }
 
-  if (overflowed) {
-    errno = EOVERFLOW;
-    return -1;
-  } else {
-    return 0;
-  }
+  return stamp_narrow(prod, seconds_out, nanoseconds_out);
 }
 
 void byztime_stamp_halve(byztime_stamp *prod, byztime_stamp const *stamp) {
@@ -245,26 +159,23 @@ void byztime_stamp_halve(byztime_stamp *prod, byztime_stamp const *stamp) {
   prod->seconds = seconds >> 1;
   prod->nanoseconds = nanoseconds >> 1;
   if (seconds & 1) prod->nanoseconds += 500000000;
-  if ((nanoseconds & 3) == 3) {
-    if (nanoseconds > 0) {
-      prod->nanoseconds++;
-    } else {
-      prod->nanoseconds--;
-    }
-  }
+  /* The shift rounds the nanoseconds down, whatever their sign. If that
+     dropped a half and left an odd result, round up to even instead. */
+  if ((nanoseconds & 3) == 3) prod->nanoseconds++;
 }
 
 int byztime_stamp_cmp(byztime_stamp const *stamp1,
                       byztime_stamp const *stamp2) {
-  byztime_stamp s1 = *stamp1, s2 = *stamp2;
+  __int128 s1, s2;
+  int64_t ns1, ns2;
 
-  (void)byztime_stamp_normalize(&s1);
-  (void)byztime_stamp_normalize(&s2);
+  stamp_widen(stamp1, &s1, &ns1);
+  stamp_widen(stamp2, &s2, &ns2);
 
-  if (s1.seconds < s2.seconds) return -1;
-  if (s1.seconds > s2.seconds) return 1;
-  if (s1.nanoseconds < s2.nanoseconds) return -1;
-  if (s1.nanoseconds > s2.nanoseconds) return 1;
+  if (s1 < s2) return -1;
+  if (s1 > s2) return 1;
+  if (ns1 < ns2) return -1;
+  if (ns1 > ns2) return 1;
   return 0;
 }
 
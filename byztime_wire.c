@@ -0,0 +1,225 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_internal.h"
+
+#include <errno.h>
+#include <string.h>
+
+/* Compact wire encoding for intervals.
+
+   A batch is encoded as:
+
+     version         1 byte, BYZTIME_WIRE_VERSION
+     count           varint
+     base.seconds    zigzag varint
+     base.nanoseconds varint, less than 1e9
+     count times:
+       est - base    zigzag varint, in nanoseconds
+       est - min     zigzag varint, in nanoseconds
+       max - est     zigzag varint, in nanoseconds
+
+   where `base` is the first interval's estimate. Varints are LEB128:
+   seven bits per byte, least significant group first, with the high bit
+   set on every byte but the last. The encoding is canonical: varints
+   are always as short as possible and decoders reject any that aren't,
+   so equal batches always encode to equal bytes.
+
+   The bounds are normally on the correct sides of the estimate, and are
+   then small non-negative numbers, but they are zigzag-encoded anyway so
+   that any interval round-trips exactly. */
+
+/* Three varints of at most ten bytes each. */
+#define WIRE_MAX_INTERVAL_LEN 30
+
+static inline uint64_t zigzag(int64_t x) {
+  return ((uint64_t)x << 1) ^ (uint64_t)(x >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t x) {
+  return (int64_t)(x >> 1) ^ -(int64_t)(x & 1);
+}
+
+static inline unsigned char *put_varint(unsigned char *p, uint64_t x) {
+  while (x >= 0x80) {
+    *p++ = (unsigned char)(x | 0x80);
+    x >>= 7;
+  }
+  *p++ = (unsigned char)x;
+  return p;
+}
+
+/* Decodes a varint from [*p, end). Returns -1 if it is truncated,
+   overlong, or overflows 64 bits. */
+static inline int get_varint(unsigned char const **p, unsigned char const *end,
+                             uint64_t *out) {
+  unsigned char const *q = *p;
+  uint64_t x = 0;
+  unsigned shift = 0;
+  unsigned char byte;
+
+  /* Single-byte values are the common case for bounds. */
+  if (q < end && *q < 0x80) {
+    *out = *q;
+    *p = q + 1;
+    return 0;
+  }
+
+  do {
+    if (q == end || shift > 63) return -1;
+    byte = *q++;
+    if (shift == 63 && byte > 1) return -1;
+    x |= (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+
+  /* A final zero byte after the first means the varint is overlong. */
+  if (byte == 0 && q - *p > 1) return -1;
+
+  *out = x;
+  *p = q;
+  return 0;
+}
+
+/* Computes a - b in nanoseconds. */
+static inline int diff_ns(int64_t *ns, byztime_stamp const *a,
+                          byztime_stamp const *b) {
+  int64_t s, n;
+  if (__builtin_sub_overflow(a->seconds, b->seconds, &s) ||
+      __builtin_sub_overflow(a->nanoseconds, b->nanoseconds, &n) ||
+      __builtin_mul_overflow(s, (int64_t)billion, ns) ||
+      __builtin_add_overflow(*ns, n, ns)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  return 0;
+}
+
+/* Computes a + ns, or a - ns if `negate`, normalized. `a` must be
+   normalized. The quotient and remainder are split before negating so
+   that INT64_MIN needs no special case. */
+static inline int offset_stamp(byztime_stamp *out, byztime_stamp const *a,
+                               int64_t ns, bool negate) {
+  int64_t s = ns / billion, n = ns % billion;
+  if (negate) {
+    s = -s;
+    n = -n;
+  }
+  n += a->nanoseconds;
+  if (n < 0) {
+    n += billion;
+    s--;
+  } else if (n >= billion) {
+    n -= billion;
+    s++;
+  }
+  if (__builtin_add_overflow(a->seconds, s, &out->seconds)) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  out->nanoseconds = n;
+  return 0;
+}
+
+int byztime_wire_encode(unsigned char *buf, size_t size, size_t *len,
+                        byztime_interval const in[], size_t n) {
+  unsigned char scratch[BYZTIME_WIRE_MAX_LEN(1)];
+  unsigned char *p = buf, *end = buf + size;
+  byztime_stamp base;
+
+  if (n > 0) {
+    base = in[0].est;
+    if (byztime_stamp_normalize(&base) < 0) return -1;
+  } else {
+    base = zerostamp;
+  }
+
+  /* Build the header aside so that its bounds are checked once. */
+  {
+    unsigned char *h = scratch;
+    *h++ = BYZTIME_WIRE_VERSION;
+    h = put_varint(h, n);
+    h = put_varint(h, zigzag(base.seconds));
+    h = put_varint(h, (uint64_t)base.nanoseconds);
+    if ((size_t)(h - scratch) > size) goto nobufs;
+    memcpy(p, scratch, (size_t)(h - scratch));
+    p += h - scratch;
+  }
+
+  for (size_t k = 0; k < n; k++) {
+    int64_t est, lo, hi;
+
+    if (diff_ns(&est, &in[k].est, &base) < 0 ||
+        diff_ns(&lo, &in[k].est, &in[k].min) < 0 ||
+        diff_ns(&hi, &in[k].max, &in[k].est) < 0)
+      return -1;
+
+    if ((size_t)(end - p) >= WIRE_MAX_INTERVAL_LEN) {
+      p = put_varint(p, zigzag(est));
+      p = put_varint(p, zigzag(lo));
+      p = put_varint(p, zigzag(hi));
+    } else {
+      unsigned char *q = scratch;
+      q = put_varint(q, zigzag(est));
+      q = put_varint(q, zigzag(lo));
+      q = put_varint(q, zigzag(hi));
+      if (q - scratch > end - p) goto nobufs;
+      memcpy(p, scratch, (size_t)(q - scratch));
+      p += q - scratch;
+    }
+  }
+
+  *len = (size_t)(p - buf);
+  return 0;
+
+nobufs:
+  errno = ENOBUFS;
+  return -1;
+}
+
+int byztime_wire_decode(byztime_interval out[], size_t cap, size_t *n,
+                        unsigned char const *buf, size_t size,
+                        size_t *consumed) {
+  unsigned char const *p = buf, *end = buf + size;
+  uint64_t count, seconds, nanoseconds;
+  byztime_stamp base;
+
+  if (p == end || *p++ != BYZTIME_WIRE_VERSION) goto proto;
+  if (get_varint(&p, end, &count) < 0 || get_varint(&p, end, &seconds) < 0 ||
+      get_varint(&p, end, &nanoseconds) < 0 || nanoseconds >= (uint64_t)billion)
+    goto proto;
+
+  /* Every interval takes at least three bytes, so a count that the
+     buffer can't hold is malformed rather than too big for `out`. */
+  if (count > (uint64_t)(end - p) / 3) goto proto;
+
+  *n = (size_t)count;
+  if (count > cap) {
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  base.seconds = unzigzag(seconds);
+  base.nanoseconds = (int64_t)nanoseconds;
+
+  for (size_t k = 0; k < count; k++) {
+    uint64_t est, lo, hi;
+
+    if (get_varint(&p, end, &est) < 0 || get_varint(&p, end, &lo) < 0 ||
+        get_varint(&p, end, &hi) < 0)
+      goto proto;
+
+    if (offset_stamp(&out[k].est, &base, unzigzag(est), false) < 0 ||
+        offset_stamp(&out[k].min, &out[k].est, unzigzag(lo), true) < 0 ||
+        offset_stamp(&out[k].max, &out[k].est, unzigzag(hi), false) < 0)
+      return -1;
+  }
+
+  if (consumed != NULL) *consumed = (size_t)(p - buf);
+  return 0;
+
+proto:
+  errno = EPROTO;
+  return -1;
+}
@@ -0,0 +1,83 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/* Helpers shared by the benchmarks under tests/. Each benchmark times a
+   loop several times over and reports the fastest round, which is the
+   one least disturbed by whatever else the machine was doing. */
+
+#ifndef BYZTIME_TESTS_BENCH_H_
+#define BYZTIME_TESTS_BENCH_H_
+
+#include "byztime.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_ROUNDS 5
+
+static inline int64_t bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void bench_report(char const *name, int64_t best_ns,
+                                uint64_t ops) {
+  printf("%-40s %8.1f ns/op\n", name, (double)best_ns / (double)ops);
+}
+
+/* Times `body`, which performs `ops` operations, over BENCH_ROUNDS
+   rounds and reports the fastest. */
+#define BENCH(name, ops, body)                                               \
+  do {                                                                       \
+    int64_t best_ = INT64_MAX;                                               \
+    for (int round_ = 0; round_ < BENCH_ROUNDS; round_++) {                  \
+      int64_t start_ = bench_now();                                          \
+      body;                                                                  \
+      int64_t elapsed_ = bench_now() - start_;                               \
+      if (elapsed_ < best_) best_ = elapsed_;                                \
+    }                                                                        \
+    bench_report(name, best_, ops);                                          \
+  } while (0)
+
+/* A provider publishing into a timedata file in a fresh temporary
+   directory, which bench_provider_close() removes again. */
+typedef struct bench_provider_s {
+  char dir[64];
+  char path[96];
+  char lock_path[104];
+  byztime_ctx *ctx;
+} bench_provider;
+
+static inline int bench_provider_open(bench_provider *p) {
+  byztime_stamp offset = {5, 0}, error = {0, 1000000}, as_of;
+
+  strcpy(p->dir, "/tmp/byztime-bench-XXXXXX");
+  if (mkdtemp(p->dir) == NULL) {
+    perror("mkdtemp");
+    return -1;
+  }
+  snprintf(p->path, sizeof p->path, "%s/timedata", p->dir);
+  snprintf(p->lock_path, sizeof p->lock_path, "%s.lock", p->path);
+
+  p->ctx = byztime_open_rw(p->path);
+  if (p->ctx == NULL || byztime_get_local_time(&as_of) < 0 ||
+      byztime_set_offset(p->ctx, &offset, &error, &as_of) < 0) {
+    perror("byztime_open_rw");
+    return -1;
+  }
+  return 0;
+}
+
+static inline void bench_provider_close(bench_provider *p) {
+  byztime_close(p->ctx);
+  unlink(p->path);
+  unlink(p->lock_path);
+  rmdir(p->dir);
+}
+
+#endif
@@ -0,0 +1,57 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/* Measures the civil date conversions, one at a time and in batches,
+   over timestamps spread across a few centuries. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+
+#define BATCH 1024
+#define REPS 1000
+
+static byztime_stamp stamps[BATCH];
+static byztime_civil civil[BATCH];
+
+int main(void) {
+  uint64_t state = 20210601;
+  int ret = 0;
+
+  for (size_t k = 0; k < BATCH; k++) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    stamps[k].seconds = (int64_t)(state >> 30) % (300LL * 365 * 86400) -
+                        (100LL * 365 * 86400);
+    stamps[k].nanoseconds = (int64_t)(state % 1000000000);
+  }
+
+  BENCH("byztime_stamp_to_civil", (uint64_t)BATCH * REPS, {
+    for (int r = 0; r < REPS; r++) {
+      for (size_t k = 0; k < BATCH; k++) {
+        if (byztime_stamp_to_civil(&civil[k], &stamps[k]) < 0) ret = 1;
+      }
+    }
+  });
+
+  BENCH("byztime_stamp_from_civil", (uint64_t)BATCH * REPS, {
+    for (int r = 0; r < REPS; r++) {
+      for (size_t k = 0; k < BATCH; k++) {
+        if (byztime_stamp_from_civil(&stamps[k], &civil[k]) < 0) ret = 1;
+      }
+    }
+  });
+
+  BENCH("byztime_stamp_to_civil_batch", (uint64_t)BATCH * REPS, {
+    for (int r = 0; r < REPS; r++) {
+      if (byztime_stamp_to_civil_batch(civil, stamps, BATCH) < 0) ret = 1;
+    }
+  });
+
+  BENCH("byztime_stamp_from_civil_batch", (uint64_t)BATCH * REPS, {
+    for (int r = 0; r < REPS; r++) {
+      if (byztime_stamp_from_civil_batch(stamps, civil, BATCH) < 0) ret = 1;
+    }
+  });
+
+  if (ret != 0) fprintf(stderr, "bench_civil: a conversion failed\n");
+  return ret;
+}
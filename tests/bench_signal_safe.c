@@ -0,0 +1,43 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/* Compares the cost of the async-signal-safe global time read with that
+   of the ordinary one, on a context reading a live timedata file. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+
+#define READS 1000000
+
+int main(void) {
+  bench_provider provider;
+  byztime_ctx *ctx;
+  byztime_stamp min, est, max;
+  int ret = 0;
+
+  if (bench_provider_open(&provider) < 0) return 1;
+  ctx = byztime_open_ro(provider.path);
+  if (ctx == NULL) {
+    perror("byztime_open_ro");
+    bench_provider_close(&provider);
+    return 1;
+  }
+
+  BENCH("byztime_get_global_time", READS, {
+    for (int k = 0; k < READS; k++) {
+      if (byztime_get_global_time(ctx, &min, &est, &max) < 0) ret = 1;
+    }
+  });
+
+  BENCH("byztime_get_global_time_signal_safe", READS, {
+    for (int k = 0; k < READS; k++) {
+      if (byztime_get_global_time_signal_safe(ctx, &min, &est, &max) != 0)
+        ret = 1;
+    }
+  });
+
+  if (ret != 0) fprintf(stderr, "bench_signal_safe: a read failed\n");
+  byztime_close(ctx);
+  bench_provider_close(&provider);
+  return ret;
+}
@@ -0,0 +1,49 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/* Measures the cost of slewing on the global time read, on a context
+   reading a live timedata file. Successive reads are close together and
+   the offset is steady, so the slewing reads should all take the fast
+   path that skips the clamp. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+
+#define READS 1000000
+
+int main(void) {
+  bench_provider provider;
+  byztime_ctx *ctx;
+  byztime_stamp min, est, max;
+  int ret = 0;
+
+  if (bench_provider_open(&provider) < 0) return 1;
+  ctx = byztime_open_ro(provider.path);
+  if (ctx == NULL) {
+    perror("byztime_open_ro");
+    bench_provider_close(&provider);
+    return 1;
+  }
+
+  BENCH("byztime_get_global_time (stepping)", READS, {
+    for (int k = 0; k < READS; k++) {
+      if (byztime_get_global_time(ctx, &min, &est, &max) < 0) ret = 1;
+    }
+  });
+
+  if (byztime_slew(ctx, 999500000, 1000500000, NULL) < 0) {
+    perror("byztime_slew");
+    ret = 1;
+  }
+
+  BENCH("byztime_get_global_time (slewing)", READS, {
+    for (int k = 0; k < READS; k++) {
+      if (byztime_get_global_time(ctx, &min, &est, &max) < 0) ret = 1;
+    }
+  });
+
+  if (ret != 0) fprintf(stderr, "bench_slew: a read failed\n");
+  byztime_close(ctx);
+  bench_provider_close(&provider);
+  return ret;
+}
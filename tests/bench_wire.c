@@ -0,0 +1,52 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/* Measures the wire encoding on a batch of intervals like those one
+   host reports over a short period: estimates a few milliseconds apart
+   and bounds within a millisecond of them. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+
+#define BATCH 1024
+#define REPS 1000
+
+static byztime_interval in[BATCH], out[BATCH];
+static unsigned char buf[BYZTIME_WIRE_MAX_LEN(BATCH)];
+
+int main(void) {
+  uint64_t state = 20210601;
+  size_t len = 0, n;
+  int ret = 0;
+
+  for (size_t k = 0; k < BATCH; k++) {
+    int64_t ns;
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    ns = 5000000 * (int64_t)k + (int64_t)(state >> 44);
+    in[k].est.seconds = 1622505600 + ns / 1000000000;
+    in[k].est.nanoseconds = ns % 1000000000;
+    in[k].min = in[k].est;
+    in[k].max = in[k].est;
+    in[k].min.nanoseconds -= (int64_t)(state >> 54);
+    in[k].max.nanoseconds += (int64_t)(state >> 54);
+    byztime_stamp_normalize(&in[k].min);
+    byztime_stamp_normalize(&in[k].max);
+  }
+
+  BENCH("byztime_wire_encode", (uint64_t)BATCH * REPS, {
+    for (int r = 0; r < REPS; r++) {
+      if (byztime_wire_encode(buf, sizeof buf, &len, in, BATCH) < 0) ret = 1;
+    }
+  });
+
+  BENCH("byztime_wire_decode", (uint64_t)BATCH * REPS, {
+    for (int r = 0; r < REPS; r++) {
+      if (byztime_wire_decode(out, BATCH, &n, buf, len, NULL) < 0) ret = 1;
+    }
+  });
+
+  if (ret != 0) fprintf(stderr, "bench_wire: a batch failed\n");
+  printf("%-40s %8.1f bytes/interval\n", "encoded size",
+         (double)len / BATCH);
+  return ret;
+}
@@ -0,0 +1,201 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_ref.h"
+
+#include <errno.h>
+#include <stdbool.h>
+
+/* Reference stamp arithmetic.
+
+   Nothing here is meant to be fast. Every value a byztime_stamp can
+   hold, normalized or not, is exactly seconds * 1e9 + nanoseconds, which
+   needs at most 94 bits, so each operation converts its inputs to
+   __int128 nanosecond counts, computes an exact result, and converts
+   back. The only product that doesn't fit in 128 bits is the one inside
+   scaling, which is formed as three 64-bit limbs and divided by 1e9 one
+   limb at a time. There is no cleverness for a bug to hide in: these
+   are the definitions that the fast paths in byztime_stamp.c and
+   byztime_columns.c are supposed to implement. */
+
+static const int billion = 1000000000;
+static const __int128 i128_max = (__int128)(~(unsigned __int128)0 >> 1);
+
+static inline __int128 ref_to_ns(byztime_stamp const *stamp) {
+  return (__int128)stamp->seconds * billion + stamp->nanoseconds;
+}
+
+/* Converts an exact count of nanoseconds to a normalized stamp. If the
+   seconds don't fit, stores them modulo 2^64 and fails with EOVERFLOW. */
+static int ref_from_ns(byztime_stamp *stamp, __int128 ns) {
+  __int128 seconds = ns / billion;
+  __int128 nanoseconds = ns % billion;
+
+  if (nanoseconds < 0) {
+    nanoseconds += billion;
+    seconds--;
+  }
+
+  stamp->seconds = (int64_t)(uint64_t)(unsigned __int128)seconds;
+  stamp->nanoseconds = (int64_t)nanoseconds;
+
+  if (seconds < INT64_MIN || seconds > INT64_MAX) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+  return 0;
+}
+
+int byztime_ref_stamp_normalize(byztime_stamp *stamp) {
+  return ref_from_ns(stamp, ref_to_ns(stamp));
+}
+
+int byztime_ref_stamp_add(byztime_stamp *sum, byztime_stamp const *stamp1,
+                          byztime_stamp const *stamp2) {
+  return ref_from_ns(sum, ref_to_ns(stamp1) + ref_to_ns(stamp2));
+}
+
+int byztime_ref_stamp_sub(byztime_stamp *diff, byztime_stamp const *stamp1,
+                          byztime_stamp const *stamp2) {
+  return ref_from_ns(diff, ref_to_ns(stamp1) - ref_to_ns(stamp2));
+}
+
+int byztime_ref_stamp_cmp(byztime_stamp const *stamp1,
+                          byztime_stamp const *stamp2) {
+  __int128 a = ref_to_ns(stamp1), b = ref_to_ns(stamp2);
+  return (a > b) - (a < b);
+}
+
+/* Rounds num / 2 or num / 1e9, given the truncated quotient's parity
+   and the remainder's magnitude, to nearest with ties to even. Operates
+   on magnitudes, so is symmetric about zero. */
+static inline bool ref_round_up(uint64_t rem, uint64_t divisor, bool odd) {
+  return 2 * rem > divisor || (2 * rem == divisor && odd);
+}
+
+int byztime_ref_stamp_scale(byztime_stamp *prod, byztime_stamp const *stamp,
+                            int64_t ppb) {
+  __int128 x = ref_to_ns(stamp);
+  bool negative = (x < 0) != (ppb < 0);
+  unsigned __int128 mag = x < 0 ? -(unsigned __int128)x : (unsigned __int128)x;
+  uint64_t p = ppb < 0 ? -(uint64_t)ppb : (uint64_t)ppb;
+  uint64_t limb[3], rem = 0;
+  unsigned __int128 lo, hi, q;
+
+  /* limb[2..0] = mag * p, most significant first. */
+  lo = (unsigned __int128)(uint64_t)mag * p;
+  hi = (unsigned __int128)(uint64_t)(mag >> 64) * p + (uint64_t)(lo >> 64);
+  limb[0] = (uint64_t)(hi >> 64);
+  limb[1] = (uint64_t)hi;
+  limb[2] = (uint64_t)lo;
+
+  /* Long division by 1e9. */
+  for (int k = 0; k < 3; k++) {
+    unsigned __int128 cur = ((unsigned __int128)rem << 64) | limb[k];
+    limb[k] = (uint64_t)(cur / (unsigned)billion);
+    rem = (uint64_t)(cur % (unsigned)billion);
+  }
+
+  /* |stamp| < 2^93 and |ppb| <= 2^63, so the quotient is below 2^127
+     and limb[0] is zero. */
+  q = ((unsigned __int128)limb[1] << 64) | limb[2];
+  if (ref_round_up(rem, (uint64_t)billion, q & 1)) q++;
+
+  if (q > (unsigned __int128)i128_max) {
+    /* Unreachable, per the above. */
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  return ref_from_ns(prod, negative ? -(__int128)q : (__int128)q);
+}
+
+void byztime_ref_stamp_halve(byztime_stamp *prod, byztime_stamp const *stamp) {
+  __int128 x = ref_to_ns(stamp);
+  unsigned __int128 mag = x < 0 ? -(unsigned __int128)x : (unsigned __int128)x;
+  unsigned __int128 q = mag >> 1;
+
+  if (ref_round_up((uint64_t)(mag & 1), 2, q & 1)) q++;
+  /* Half of any stamp is representable. */
+  (void)ref_from_ns(prod, x < 0 ? -(__int128)q : (__int128)q);
+}
+
+/* splitmix64, chosen because its whole state is one word that callers
+   can seed and store however they like. */
+static uint64_t ref_next(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+uint64_t byztime_ref_gen_u64(uint64_t *state) { return ref_next(state); }
+
+static int64_t ref_pick(uint64_t *state, int64_t const choices[], size_t n) {
+  return choices[ref_next(state) % n];
+}
+
+#define REF_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+void byztime_ref_gen_stamp(uint64_t *state, byztime_stamp *out, int flags) {
+  static const int64_t seconds[] = {
+      0,         1,           -1,           2,         -2,
+      INT64_MAX, INT64_MAX - 1, INT64_MIN,  INT64_MIN + 1,
+      billion,   -billion,    INT64_MAX / 2, INT64_MIN / 2,
+      INT64_MAX / billion,    INT64_MIN / billion};
+  static const int64_t nanoseconds[] = {
+      0, 1, 2, 3, billion - 1, billion - 2, billion / 2, billion / 2 - 1,
+      billion / 2 + 1};
+  static const int64_t wild_nanoseconds[] = {
+      -1,        -2,          billion,   -billion,      billion + 1,
+      -billion - 1, 2 * billion, INT64_MAX, INT64_MIN,  INT64_MAX - 1,
+      INT64_MIN + 1};
+  uint64_t r = ref_next(state);
+
+  /* Each field is a special value a third of the time, a small random
+     value a third of the time, and fully random otherwise. */
+  switch (r % 3) {
+    case 0:
+      out->seconds = ref_pick(state, seconds, REF_COUNT(seconds));
+      break;
+    case 1:
+      out->seconds = (int64_t)(ref_next(state) % 2001) - 1000;
+      break;
+    default:
+      out->seconds = (int64_t)ref_next(state);
+      break;
+  }
+
+  r /= 3;
+  if ((flags & BYZTIME_REF_GEN_UNNORMALIZED) && r % 4 == 0) {
+    out->nanoseconds = r % 8 == 0 ? (int64_t)ref_next(state)
+                                  : ref_pick(state, wild_nanoseconds,
+                                             REF_COUNT(wild_nanoseconds));
+  } else if (r % 2 == 0) {
+    out->nanoseconds = ref_pick(state, nanoseconds, REF_COUNT(nanoseconds));
+  } else {
+    out->nanoseconds = (int64_t)(ref_next(state) % billion);
+  }
+}
+
+int64_t byztime_ref_gen_ppb(uint64_t *state) {
+  static const int64_t ppbs[] = {
+      0,           1,           -1,          billion,       -billion,
+      billion - 1, billion + 1, billion / 2, billion / 2 + 1,
+      2 * billion, -2 * billion, 999999,     1000001,       INT64_MAX,
+      INT64_MIN,   INT64_MAX - 1, INT64_MIN + 1};
+  uint64_t r = ref_next(state);
+
+  switch (r % 4) {
+    case 0:
+      return ref_pick(state, ppbs, REF_COUNT(ppbs));
+    case 1:
+      return (int64_t)(ref_next(state) % (2 * (uint64_t)billion + 1)) -
+             billion;
+    case 2:
+      return billion + (int64_t)(ref_next(state) % 2000001) - 1000000;
+    default:
+      return (int64_t)ref_next(state);
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/* Reference stamp arithmetic.
+
+   Slow but exact implementations of the stamp operations, and a
+   generator of awkward inputs for them, for testing the library's fast
+   implementations against. This is test code: it is neither built into
+   libbyztime nor installed.
+
+   Each reference function computes its result exactly using wide
+   integers and then rounds once, to nearest with ties to even where
+   rounding is needed. Its result is always normalized. On overflow, a
+   reference function stores the exact result with its `seconds` field
+   reduced modulo 2^64, and fails with `EOVERFLOW`. It fails only if the
+   exact result is unrepresentable. The fast functions are expected to
+   agree exactly, except that byztime_stamp_halve() may leave its result
+   unnormalized. */
+
+#ifndef BYZTIME_TESTS_BYZTIME_REF_H_
+#define BYZTIME_TESTS_BYZTIME_REF_H_
+
+#include "byztime.h"
+
+/** Reference version of byztime_stamp_normalize(). */
+int byztime_ref_stamp_normalize(byztime_stamp *stamp);
+
+/** Reference version of byztime_stamp_add(). */
+int byztime_ref_stamp_add(byztime_stamp *sum, byztime_stamp const *stamp1,
+                          byztime_stamp const *stamp2);
+
+/** Reference version of byztime_stamp_sub(). */
+int byztime_ref_stamp_sub(byztime_stamp *diff, byztime_stamp const *stamp1,
+                          byztime_stamp const *stamp2);
+
+/** Reference version of byztime_stamp_cmp(). */
+int byztime_ref_stamp_cmp(byztime_stamp const *stamp1,
+                          byztime_stamp const *stamp2);
+
+/** Reference version of byztime_stamp_scale(). */
+int byztime_ref_stamp_scale(byztime_stamp *prod, byztime_stamp const *stamp,
+                            int64_t ppb);
+
+/** Reference version of byztime_stamp_halve(). Unlike that function, this
+    always produces a normalized result. */
+void byztime_ref_stamp_halve(byztime_stamp *prod, byztime_stamp const *stamp);
+
+/** Returns the next uniformly distributed 64-bit word from the generator
+    that byztime_ref_gen_stamp() and byztime_ref_gen_ppb() draw on, for
+    tests that need plain random numbers alongside awkward ones.
+
+    \param[in,out] state Generator state. Any value is a valid seed.
+*/
+uint64_t byztime_ref_gen_u64(uint64_t *state);
+
+/** Flag for byztime_ref_gen_stamp(): also generate stamps whose
+    `nanoseconds` field is outside [0, 1000000000). */
+#define BYZTIME_REF_GEN_UNNORMALIZED 1
+
+/** Generates a stamp that is likely to exercise edge cases.
+
+    Stamps are drawn from a mix of special values, such as the limits of
+    `int64_t`, seconds near zero, and nanoseconds near 0, 500000000 and
+    999999999, together with small and fully random values. The sequence
+    is determined entirely by `*state`, so any failure can be reproduced
+    from the seed.
+
+    \param[in,out] state Generator state. Any value is a valid seed.
+    \param[out] out The generated stamp.
+    \param[in] flags Zero or `BYZTIME_REF_GEN_UNNORMALIZED`.
+*/
+void byztime_ref_gen_stamp(uint64_t *state, byztime_stamp *out, int flags);
+
+/** Generates a scale factor for byztime_stamp_scale(), as for
+    byztime_ref_gen_stamp(). The values favour those near 0, near
+    1000000000 and at the limits of `int64_t`.
+
+    \param[in,out] state Generator state.
+
+    \returns The generated factor, in parts per billion.
+*/
+int64_t byztime_ref_gen_ppb(uint64_t *state);
+
+#endif
@@ -0,0 +1,88 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/* Tests that the real-time publisher resolves a NULL `as_of` to the
+   local time of the enqueue, both in the slot it fills and in the entry
+   it eventually publishes. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_internal.h"
+#include "bench.h"
+
+static int failures;
+
+static void check(bool ok, char const *what) {
+  if (!ok) {
+    fprintf(stderr, "rt_enqueue: %s\n", what);
+    failures++;
+  }
+}
+
+static bool between(byztime_stamp const *lo, byztime_stamp const *x,
+                    byztime_stamp const *hi) {
+  return byztime_stamp_cmp(lo, x) <= 0 && byztime_stamp_cmp(x, hi) <= 0;
+}
+
+static void check_slot(void) {
+  byztime_stamp offset = {7, 0}, error = {0, 500}, as_of = {3, 4};
+  byztime_stamp before, after;
+  rt_slot slot;
+
+  memset(&slot, 0, sizeof slot);
+  check(byztime_rt_fill_slot(&slot, &offset, &error, &as_of) == 0,
+        "fill_slot failed with an explicit as_of");
+  check(byztime_stamp_cmp(&slot.as_of, &as_of) == 0,
+        "explicit as_of not copied into the slot");
+
+  memset(&slot, 0, sizeof slot);
+  check(byztime_get_local_time(&before) == 0, "local clock unreadable");
+  check(byztime_rt_fill_slot(&slot, &offset, &error, NULL) == 0,
+        "fill_slot failed with a NULL as_of");
+  check(byztime_get_local_time(&after) == 0, "local clock unreadable");
+  check(between(&before, &slot.as_of, &after),
+        "NULL as_of not resolved to the time of the enqueue");
+  check(byztime_stamp_cmp(&slot.offset, &offset) == 0 &&
+            byztime_stamp_cmp(&slot.error, &error) == 0,
+        "offset or error not copied into the slot");
+}
+
+static void check_published(void) {
+  byztime_stamp offset = {7, 0}, error = {0, 500};
+  byztime_stamp before, after, got_offset, got_error, got_as_of;
+  bench_provider provider;
+  byztime_rt_publisher *pub;
+
+  if (bench_provider_open(&provider) < 0) {
+    failures++;
+    return;
+  }
+  pub = byztime_rt_start(provider.ctx, -1, 0, 0);
+  check(pub != NULL, "byztime_rt_start failed");
+  if (pub != NULL) {
+    check(byztime_get_local_time(&before) == 0, "local clock unreadable");
+    check(byztime_rt_enqueue(pub, &offset, &error, NULL) == 0,
+          "byztime_rt_enqueue failed with a NULL as_of");
+    check(byztime_get_local_time(&after) == 0, "local clock unreadable");
+    /* Stopping publishes everything enqueued before it. */
+    check(byztime_rt_stop(pub) == 0, "byztime_rt_stop failed");
+
+    byztime_get_offset_raw(provider.ctx, &got_offset, &got_error,
+                           &got_as_of);
+    check(byztime_stamp_cmp(&got_offset, &offset) == 0,
+          "enqueued offset not published");
+    check(between(&before, &got_as_of, &after),
+          "published as_of is not the time of the enqueue");
+  }
+  bench_provider_close(&provider);
+}
+
+int main(void) {
+  check_slot();
+  check_published();
+  if (failures > 0) {
+    fprintf(stderr, "rt_enqueue: %d failures\n", failures);
+    return 1;
+  }
+  printf("rt_enqueue: passed\n");
+  return 0;
+}
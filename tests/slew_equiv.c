@@ -0,0 +1,231 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/* Equivalence tests of the integer fast paths of global time reads
+   against their full computations.
+
+   Usage: slew_equiv [seed [cases]]
+
+   Each case sets up a context as byztime_slew() would, records a
+   previous read in it, and feeds the same local time and offset to
+   byztime_slew_unclamped() and byztime_slew_clamp(). Wherever the fast
+   path claims that no clamp is needed, the full computation must
+   succeed and return the offset unchanged. Half the cases model
+   realistic reads: nearby local times, small offset adjustments and
+   rates within a few hundred parts per million of one. The rest use
+   the reference generator's edge cases for every input.
+
+   Each case also publishes a random entry's linear model as the
+   provider would, and evaluates it at a local time up to a few hours
+   either side of as_of. Its bounds must contain those of
+   byztime_entry_global_time() at the same local time, and be no wider
+   than the rounding of its error multiplier allows. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_internal.h"
+#include "byztime_ref.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_SEED 20210601
+#define DEFAULT_CASES 15000000
+#define MAX_REPORTS 10
+
+/* Returns a uniformly distributed integer in [lo, hi]. */
+static int64_t uniform(uint64_t *state, int64_t lo, int64_t hi) {
+  return lo + (int64_t)(byztime_ref_gen_u64(state) %
+                        ((uint64_t)hi - (uint64_t)lo + 1));
+}
+
+static void add_ns(byztime_stamp *out, byztime_stamp const *in, int64_t ns) {
+  byztime_stamp delta = {ns / billion, ns % billion};
+  (void)byztime_stamp_add(out, in, &delta);
+}
+
+static void gen_realistic(uint64_t *state, byztime_ctx *ctx,
+                          byztime_stamp *local_time, byztime_stamp *offset) {
+  int64_t min_rate, max_rate;
+
+  min_rate = billion - uniform(state, 0, 500000);
+  max_rate = uniform(state, 0, 7) == 0
+                 ? INT64_MAX
+                 : billion + uniform(state, 0, 500000);
+  byztime_slew_set_rates(ctx, min_rate, max_rate);
+
+  ctx->prev_local_time.seconds = uniform(state, 0, 100000000);
+  ctx->prev_local_time.nanoseconds = uniform(state, 0, billion - 1);
+  ctx->prev_offset.seconds = uniform(state, -2000000000, 2000000000);
+  ctx->prev_offset.nanoseconds = uniform(state, 0, billion - 1);
+
+  /* Reads from nanoseconds to minutes apart, occasionally out of order
+     between threads, with the offset moving by up to a millisecond. */
+  switch (uniform(state, 0, 3)) {
+    case 0:
+      add_ns(local_time, &ctx->prev_local_time, uniform(state, 0, 5000));
+      break;
+    case 1:
+      add_ns(local_time, &ctx->prev_local_time,
+             uniform(state, 0, 60 * (int64_t)billion));
+      break;
+    case 2:
+      add_ns(local_time, &ctx->prev_local_time, uniform(state, -100000, 0));
+      break;
+    default:
+      add_ns(local_time, &ctx->prev_local_time,
+             uniform(state, 0, 1000000000));
+      break;
+  }
+  add_ns(offset, &ctx->prev_offset,
+         uniform(state, 0, 1) ? 0 : uniform(state, -1000000, 1000000));
+}
+
+static void gen_edge(uint64_t *state, byztime_ctx *ctx,
+                     byztime_stamp *local_time, byztime_stamp *offset) {
+  int64_t min_rate = byztime_ref_gen_ppb(state);
+  int64_t max_rate = byztime_ref_gen_ppb(state);
+
+  byztime_slew_set_rates(ctx, min_rate, max_rate);
+  byztime_ref_gen_stamp(state, &ctx->prev_local_time, 0);
+  byztime_ref_gen_stamp(state, &ctx->prev_offset, 0);
+  byztime_ref_gen_stamp(state, local_time, 0);
+  byztime_ref_gen_stamp(state, offset, 0);
+}
+
+/* Checks the linear model against byztime_entry_global_time() at one
+   local time. Returns true if the local time preceded as_of. */
+static bool check_linear(uint64_t *state, uint64_t seed, unsigned long n,
+                         unsigned long *failures) {
+  byztime_ctx ctx;
+  timedata_entry entry;
+  timedata_aux aux;
+  byztime_interval ref;
+  int64_t offset_ns, local_ns, min = 0, est = 0, max = 0, ref_min = 0,
+                                ref_est = 0, ref_max = 0;
+  int64_t slack;
+  __int128 age;
+  int ret, ref_ret;
+
+  memset(&ctx, 0, sizeof ctx);
+  memset(&entry, 0, sizeof entry);
+  memset(&aux, 0, sizeof aux);
+
+  byztime_set_drift(&ctx, uniform(state, 0, 1000000));
+  ctx.measured_drift = uniform(state, 0, 1);
+  aux.drift_ppb = uniform(state, 0, 1) ? uniform(state, 0, 1000000) : 0;
+
+  offset_ns = uniform(state, -2000000000000000000, 2000000000000000000);
+  ns_to_stamp(&entry.offset, offset_ns);
+  ns_to_stamp(&entry.error, uniform(state, 0, billion));
+  ns_to_stamp(&entry.as_of, uniform(state, 0, 1000000000000000));
+  byztime_compute_linear_model(&entry, &aux);
+
+  local_ns = aux.as_of_ns + uniform(state, -10000000000000, 10000000000000);
+  age = (__int128)local_ns - aux.as_of_ns;
+  if (age < 0) age = -age;
+
+  ret = byztime_entry_global_time_linear_ns(&ctx, &aux, local_ns, 0, &min,
+                                            &est, &max);
+  ref_ret = byztime_entry_global_time(&ctx, &entry, &aux, local_ns, local_ns,
+                                      local_ns, &ref);
+  if (ref_ret == 0 && (stamp_to_ns(&ref_min, &ref.min) < 0 ||
+                       stamp_to_ns(&ref_est, &ref.est) < 0 ||
+                       stamp_to_ns(&ref_max, &ref.max) < 0))
+    ref_ret = -1;
+
+  /* The multiplier rounds up by less than one part in 2^32. */
+  slack = (int64_t)(age >> ERR_MULT_SHIFT) + 2;
+  if (aux.lin_mult == 0 || ret < 0 || ref_ret < 0 || est != ref_est ||
+      min > ref_min || max < ref_max || ref_min - min > slack ||
+      max - ref_max > slack) {
+    if ((*failures)++ < MAX_REPORTS) {
+      fprintf(stderr,
+              "slew_equiv: seed %" PRIu64 " case %lu: linear model at local "
+              "%" PRId64 ", as_of %" PRId64 ", drift %" PRId64 "/%" PRId64
+              ": got [%" PRId64 ", %" PRId64 ", %" PRId64 "] (%d), want [%" PRId64
+              ", %" PRId64 ", %" PRId64 "] (%d)\n",
+              seed, n, local_ns, aux.as_of_ns, ctx.drift_ppb, aux.drift_ppb,
+              min, est, max, ret, ref_min, ref_est, ref_max, ref_ret);
+    }
+  }
+  return local_ns < aux.as_of_ns;
+}
+
+int main(int argc, char **argv) {
+  byztime_ctx ctx;
+  unsigned long cases = DEFAULT_CASES, hits = 0, realistic_hits = 0,
+                before_as_of = 0, failures = 0;
+  uint64_t seed = DEFAULT_SEED, state;
+
+  if (argc > 1) seed = strtoull(argv[1], NULL, 0);
+  if (argc > 2) cases = strtoul(argv[2], NULL, 0);
+  state = seed;
+
+  memset(&ctx, 0, sizeof ctx);
+  ctx.slew_mode = true;
+  ctx.slew_have_prev = true;
+
+  for (unsigned long n = 0; n < cases; n++) {
+    byztime_stamp local_time, offset, est;
+    bool realistic = n % 2 == 0;
+    int ret;
+
+    if (check_linear(&state, seed, n, &failures)) before_as_of++;
+
+    if (realistic) {
+      gen_realistic(&state, &ctx, &local_time, &offset);
+    } else {
+      gen_edge(&state, &ctx, &local_time, &offset);
+    }
+
+    if (!byztime_slew_unclamped(&ctx, &local_time, &offset)) continue;
+    hits++;
+    if (realistic) realistic_hits++;
+
+    ret = byztime_slew_clamp(&ctx, &local_time, &offset, &est);
+    if (ret < 0 || est.seconds != offset.seconds ||
+        est.nanoseconds != offset.nanoseconds) {
+      if (failures++ < MAX_REPORTS) {
+        fprintf(stderr,
+                "slew_equiv: seed %" PRIu64 " case %lu: rates [%" PRId64
+                ", %" PRId64 "], prev {%" PRId64 ", %" PRId64 "} + {%" PRId64
+                ", %" PRId64 "}, now {%" PRId64 ", %" PRId64 "} + {%" PRId64
+                ", %" PRId64 "}: full path gave {%" PRId64 ", %" PRId64
+                "} (%d)\n",
+                seed, n, ctx.min_rate_ppb, ctx.max_rate_ppb,
+                ctx.prev_local_time.seconds, ctx.prev_local_time.nanoseconds,
+                ctx.prev_offset.seconds, ctx.prev_offset.nanoseconds,
+                local_time.seconds, local_time.nanoseconds, offset.seconds,
+                offset.nanoseconds, est.seconds, est.nanoseconds, ret);
+      }
+    }
+  }
+
+  if (failures > 0) {
+    fprintf(stderr, "slew_equiv: %lu failures\n", failures);
+    return 1;
+  }
+
+  /* A fast path that never fires would pass trivially. */
+  if (realistic_hits < cases / 4) {
+    fprintf(stderr,
+            "slew_equiv: fast path taken for only %lu of %lu realistic "
+            "reads\n",
+            realistic_hits, (cases + 1) / 2);
+    return 1;
+  }
+
+  if (before_as_of < cases / 4) {
+    fprintf(stderr,
+            "slew_equiv: only %lu of %lu linear model reads preceded as_of\n",
+            before_as_of, cases);
+    return 1;
+  }
+
+  printf("slew_equiv: %lu cases passed, fast path taken in %lu, %lu reads "
+         "before as_of (seed %" PRIu64 ")\n",
+         cases, hits, before_as_of, seed);
+  return 0;
+}
@@ -0,0 +1,260 @@
+// Copyright 2021, Akamai Technologies, Inc.
+// SPDX-License-Identifier: Apache-2.0
+
+/* Differential test of the stamp functions and column kernels against
+   the reference arithmetic in byztime_ref.c, over inputs drawn by its
+   edge-case generator.
+
+   Usage: stamp_diff [seed [cases]]
+
+   Every run with the same seed checks the same inputs, and a failure
+   reports the seed and case number needed to reproduce it. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "byztime_ref.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_SEED 20210601
+#define DEFAULT_CASES 1000000
+/* Enough columns to cover any vector width plus a scalar tail. */
+#define NCOLS 67
+#define MAX_REPORTS 10
+
+static uint64_t seed;
+static unsigned long failures;
+
+static bool same(byztime_stamp const *a, byztime_stamp const *b) {
+  return a->seconds == b->seconds && a->nanoseconds == b->nanoseconds;
+}
+
+static void report(char const *op, unsigned long n, byztime_stamp const *a,
+                   byztime_stamp const *b, int64_t ppb,
+                   byztime_stamp const *got, int got_ret,
+                   byztime_stamp const *want, int want_ret) {
+  if (failures++ >= MAX_REPORTS) return;
+  fprintf(stderr,
+          "%s: seed %" PRIu64 " case %lu: a = {%" PRId64 ", %" PRId64
+          "}, b = {%" PRId64 ", %" PRId64 "}, ppb = %" PRId64
+          ": got {%" PRId64 ", %" PRId64 "} (%d), want {%" PRId64
+          ", %" PRId64 "} (%d)\n",
+          op, seed, n, a->seconds, a->nanoseconds, b->seconds,
+          b->nanoseconds, ppb, got->seconds, got->nanoseconds, got_ret,
+          want->seconds, want->nanoseconds, want_ret);
+}
+
+/* Fails with EOVERFLOW only where the reference does, and stores the
+   same value, wrapped or not. */
+static void check_result(char const *op, unsigned long n,
+                         byztime_stamp const *a, byztime_stamp const *b,
+                         int64_t ppb, byztime_stamp const *got, int got_ret,
+                         int got_errno, byztime_stamp const *want,
+                         int want_ret) {
+  if (got_ret != want_ret || (got_ret < 0 && got_errno != EOVERFLOW) ||
+      !same(got, want)) {
+    report(op, n, a, b, ppb, got, got_ret, want, want_ret);
+  }
+}
+
+static void check_scalar(unsigned long n, byztime_stamp const *a,
+                         byztime_stamp const *b, int64_t ppb) {
+  byztime_stamp got, want;
+  int got_ret, got_errno, want_ret;
+  byztime_stamp const none = {0, 0};
+
+  got = *a;
+  errno = 0;
+  got_ret = byztime_stamp_normalize(&got);
+  got_errno = errno;
+  want = *a;
+  want_ret = byztime_ref_stamp_normalize(&want);
+  check_result("normalize", n, a, &none, 0, &got, got_ret, got_errno, &want,
+               want_ret);
+
+  errno = 0;
+  got_ret = byztime_stamp_add(&got, a, b);
+  got_errno = errno;
+  want_ret = byztime_ref_stamp_add(&want, a, b);
+  check_result("add", n, a, b, 0, &got, got_ret, got_errno, &want, want_ret);
+
+  errno = 0;
+  got_ret = byztime_stamp_sub(&got, a, b);
+  got_errno = errno;
+  want_ret = byztime_ref_stamp_sub(&want, a, b);
+  check_result("sub", n, a, b, 0, &got, got_ret, got_errno, &want, want_ret);
+
+  errno = 0;
+  got_ret = byztime_stamp_scale(&got, a, ppb);
+  got_errno = errno;
+  want_ret = byztime_ref_stamp_scale(&want, a, ppb);
+  check_result("scale", n, a, &none, ppb, &got, got_ret, got_errno, &want,
+               want_ret);
+
+  /* Halving may leave the result unnormalized, so compare values. */
+  byztime_stamp_halve(&got, a);
+  byztime_ref_stamp_halve(&want, a);
+  if (byztime_ref_stamp_cmp(&got, &want) != 0) {
+    report("halve", n, a, &none, 0, &got, 0, &want, 0);
+  }
+
+  if (byztime_stamp_cmp(a, b) != byztime_ref_stamp_cmp(a, b)) {
+    byztime_stamp c = {byztime_stamp_cmp(a, b), 0};
+    byztime_stamp d = {byztime_ref_stamp_cmp(a, b), 0};
+    report("cmp", n, a, b, 0, &c, 0, &d, 0);
+  }
+}
+
+/* Checks each kernel on one batch of normalized columns, both into
+   separate outputs and in place. */
+static void check_columns(unsigned long n, byztime_stamp const a[],
+                          byztime_stamp const b[], byztime_stamp const *lo,
+                          byztime_stamp const *hi) {
+  int64_t as[NCOLS], ans[NCOLS], bs[NCOLS], bns[NCOLS], os[NCOLS],
+      ons[NCOLS];
+  byztime_stamp_columns ac = {as, ans}, bc = {bs, bns}, oc = {os, ons};
+  byztime_stamp got[NCOLS], want[NCOLS];
+  int8_t cmp[NCOLS];
+  uint8_t mask[NCOLS];
+  size_t indices[NCOLS], count, expect_count;
+  int want_ret[NCOLS], any_overflow, ret;
+  byztime_stamp const none = {0, 0};
+
+  byztime_columns_from_stamps(&ac, a, NCOLS);
+  byztime_columns_from_stamps(&bc, b, NCOLS);
+  byztime_columns_to_stamps(got, &ac, NCOLS);
+  for (size_t k = 0; k < NCOLS; k++) {
+    if (!same(&got[k], &a[k])) {
+      report("columns round trip", n, &a[k], &none, 0, &got[k], 0, &a[k], 0);
+    }
+  }
+
+  for (int op = 0; op < 2; op++) {
+    char const *name = op == 0 ? "columns_add" : "columns_sub";
+    for (int in_place = 0; in_place < 2; in_place++) {
+      byztime_stamp_columns const *out = in_place ? &ac : &oc;
+
+      byztime_columns_from_stamps(&ac, a, NCOLS);
+      any_overflow = 0;
+      for (size_t k = 0; k < NCOLS; k++) {
+        want_ret[k] = op == 0 ? byztime_ref_stamp_add(&want[k], &a[k], &b[k])
+                              : byztime_ref_stamp_sub(&want[k], &a[k], &b[k]);
+        any_overflow |= want_ret[k] < 0;
+      }
+
+      errno = 0;
+      ret = op == 0 ? byztime_columns_add(out, &ac, &bc, NCOLS)
+                    : byztime_columns_sub(out, &ac, &bc, NCOLS);
+      if ((ret < 0) != any_overflow || (ret < 0 && errno != EOVERFLOW)) {
+        report(name, n, &a[0], &b[0], 0, &none, ret, &none, -any_overflow);
+      }
+
+      byztime_columns_to_stamps(got, out, NCOLS);
+      for (size_t k = 0; k < NCOLS; k++) {
+        if (!same(&got[k], &want[k])) {
+          report(name, n, &a[k], &b[k], 0, &got[k], ret, &want[k],
+                 want_ret[k]);
+        }
+      }
+    }
+  }
+
+  byztime_columns_from_stamps(&ac, a, NCOLS);
+  byztime_columns_cmp(cmp, &ac, &bc, NCOLS);
+  for (size_t k = 0; k < NCOLS; k++) {
+    int c = byztime_ref_stamp_cmp(&a[k], &b[k]);
+    if (cmp[k] != c) {
+      byztime_stamp g = {cmp[k], 0}, w = {c, 0};
+      report("columns_cmp", n, &a[k], &b[k], 0, &g, 0, &w, 0);
+    }
+  }
+
+  for (int op = 0; op < 2; op++) {
+    char const *name = op == 0 ? "columns_min" : "columns_max";
+    if (op == 0) {
+      byztime_columns_min(&oc, &ac, &bc, NCOLS);
+    } else {
+      byztime_columns_max(&oc, &ac, &bc, NCOLS);
+    }
+    byztime_columns_to_stamps(got, &oc, NCOLS);
+    for (size_t k = 0; k < NCOLS; k++) {
+      int c = byztime_ref_stamp_cmp(&a[k], &b[k]);
+      byztime_stamp const *w =
+          (op == 0 ? c <= 0 : c >= 0) ? &a[k] : &b[k];
+      if (!same(&got[k], w)) {
+        report(name, n, &a[k], &b[k], 0, &got[k], 0, w, 0);
+      }
+    }
+  }
+
+  byztime_columns_in_range(mask, &ac, lo, hi, NCOLS);
+  count = byztime_columns_filter(indices, &ac, lo, hi, NCOLS);
+  expect_count = 0;
+  for (size_t k = 0; k < NCOLS; k++) {
+    bool in = byztime_ref_stamp_cmp(lo, &a[k]) <= 0 &&
+              byztime_ref_stamp_cmp(&a[k], hi) <= 0;
+    if (mask[k] != in) {
+      report("columns_in_range", n, &a[k], lo, 0, &none, mask[k], hi, in);
+    }
+    if (in) {
+      if (expect_count >= count || indices[expect_count] != k) {
+        report("columns_filter", n, &a[k], lo, 0, &none, (int)count, hi,
+               (int)k);
+      }
+      expect_count++;
+    }
+  }
+  if (count != expect_count) {
+    report("columns_filter", n, lo, hi, 0, &none, (int)count, &none,
+           (int)expect_count);
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long cases = DEFAULT_CASES;
+  uint64_t state;
+
+  seed = DEFAULT_SEED;
+  if (argc > 1) seed = strtoull(argv[1], NULL, 0);
+  if (argc > 2) cases = strtoul(argv[2], NULL, 0);
+  state = seed;
+
+  for (unsigned long n = 0; n < cases; n++) {
+    byztime_stamp a, b;
+    int flags = n % 2 ? BYZTIME_REF_GEN_UNNORMALIZED : 0;
+
+    byztime_ref_gen_stamp(&state, &a, flags);
+    byztime_ref_gen_stamp(&state, &b, flags);
+    check_scalar(n, &a, &b, byztime_ref_gen_ppb(&state));
+  }
+
+  /* The kernels require normalized inputs. */
+  for (unsigned long n = 0; n < cases / NCOLS; n++) {
+    byztime_stamp a[NCOLS], b[NCOLS], lo, hi;
+
+    for (size_t k = 0; k < NCOLS; k++) {
+      byztime_ref_gen_stamp(&state, &a[k], 0);
+      byztime_ref_gen_stamp(&state, &b[k], 0);
+    }
+    /* Bound the range by two of the inputs, so that it has a fair
+       chance of containing some and excluding others. */
+    lo = a[n % NCOLS];
+    hi = b[n % NCOLS];
+    if (byztime_ref_stamp_cmp(&lo, &hi) > 0) {
+      byztime_stamp t = lo;
+      lo = hi;
+      hi = t;
+    }
+    check_columns(n, a, b, &lo, &hi);
+  }
+
+  if (failures > 0) {
+    fprintf(stderr, "stamp_diff: %lu failures\n", failures);
+    return 1;
+  }
+  printf("stamp_diff: %lu cases passed (seed %" PRIu64 ")\n", cases, seed);
+  return 0;
+}